@@ -0,0 +1,98 @@
+#include "rtweekend.hpp"
+
+#include "bvh.hpp"
+#include "scene_arena.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ *  Builds a bvh over a large random cloud of spheres with every bvh_quality and reports the build
+ *  time, the SAH cost of the tree and the rate at which it traces random rays through the cloud.
+ *  The serial SAH build (reference) is the baseline of the speedups. Every tree must find the
+ *  same hits; their number is reported as a sanity check.
+ *
+ *  usage: bvh_bench [spheres (1000000)] [rays (1000000)] [threads]
+ */
+
+using bench_clock = std::chrono::steady_clock;
+
+struct bench_result
+{
+  double build_seconds;
+  double sah_cost;
+  std::size_t bytes;
+  double rays_per_second;
+  long hits;
+};
+
+static bench_result run(const std::vector<const sphere*>& objects, const std::vector<ray>& rays,
+                        const bvh_options& options)
+{
+  bench_result result;
+  auto start = bench_clock::now();
+  bvh tree(objects, options);
+  result.build_seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+  result.sah_cost = tree.sah_cost();
+  result.bytes = tree.bytes();
+
+  hit_record rec;
+  result.hits = 0;
+  start = bench_clock::now();
+  for (const auto& r : rays)
+    if (tree.hit(r, 0.001, infinity, rec))
+      result.hits++;
+  result.rays_per_second = rays.size() / std::chrono::duration<double>(bench_clock::now() - start).count();
+  return result;
+}
+
+int main(int argc, char** argv)
+{
+  const int n_spheres = argc > 1 ? std::stoi(argv[1]) : 1000000;
+  const int n_rays = argc > 2 ? std::stoi(argv[2]) : 1000000;
+  bvh_options options;
+  if (argc > 3)
+    options.threads = std::stoi(argv[3]);
+
+  // spheres of radius 0.3 about one unit apart, in a cube
+  scene_arena world;
+  world.reserve(n_spheres);
+  const material* m = world.make_lambertian(color(0.5, 0.5, 0.5));
+  const double side = std::cbrt(static_cast<double>(n_spheres));
+  std::vector<const sphere*> objects;
+  objects.reserve(n_spheres);
+  for (int i = 0; i < n_spheres; i++)
+  {
+    point3 center(random_double(0, side), random_double(0, side), random_double(0, side));
+    objects.push_back(world.add_sphere(center, random_double(0.1, 0.5), m));
+  }
+
+  // rays from random points of the cube in random directions
+  std::vector<ray> rays;
+  rays.reserve(n_rays);
+  for (int i = 0; i < n_rays; i++)
+    rays.emplace_back(point3(random_double(0, side), random_double(0, side), random_double(0, side)),
+                      random_unit_vector());
+
+  std::cout << n_spheres << " spheres, " << n_rays << " rays, " << options.threads << " threads\n";
+
+  const char* names[] = { "reference", "fast", "balanced" };
+  const bvh_quality qualities[] = { bvh_quality::reference, bvh_quality::fast, bvh_quality::balanced };
+  bench_result baseline;
+  for (int q = 0; q < 3; q++)
+  {
+    options.quality = qualities[q];
+    auto result = run(objects, rays, options);
+    if (q == 0)
+      baseline = result;
+    std::cout << names[q] << ": build " << result.build_seconds << " s (x"
+              << baseline.build_seconds / result.build_seconds << "), SAH cost " << result.sah_cost << ", "
+              << result.bytes / (1024.0 * 1024.0) << " MiB, " << result.rays_per_second / 1e6 << " Mrays/s ("
+              << 100 * result.rays_per_second / baseline.rays_per_second << "% of reference), " << result.hits
+              << " hits\n";
+  }
+  return 0;
+}
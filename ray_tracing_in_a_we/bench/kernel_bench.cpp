@@ -0,0 +1,109 @@
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "material.hpp"
+#include "scene_arena.hpp"
+#include "render_kernel.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ *  Compares the generic render kernel with the kernel picked by select_kernel
+ *  for a few fixed configurations (camera model, lights in the scene).
+ *  Both kernels render the same image; the mean pixel value is reported as a sanity check.
+ *  The two kernels are run alternately and the best of the runs is kept, to reduce timing noise.
+ *
+ *  usage: kernel_bench [samples_per_pixel] [runs]
+ */
+
+using bench_clock = std::chrono::steady_clock;
+
+static void spheres_scene(scene_arena& world, bool with_light)
+{
+  world.add_sphere(point3(0, -1000, 0), 1000, world.make_lambertian(color(0.5, 0.5, 0.5)));
+  for (int a = -5; a < 5; a++)
+  {
+    for (int b = -5; b < 5; b++)
+    {
+      auto choose_mat = random_double();
+      point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+      const material* m;
+      if (choose_mat < 0.8)
+        m = world.make_lambertian(color::random() * color::random());
+      else if (choose_mat < 0.95)
+        m = world.make_metal(color::random(0.5, 1), random_double(0, 0.5));
+      else
+        m = world.make_dielectric(1.5);
+      world.add_sphere(center, 0.2, m);
+    }
+  }
+  world.add_sphere(point3(0, 1, 0), 1.0, world.make_dielectric(1.5));
+  world.add_sphere(point3(-4, 1, 0), 1.0, world.make_lambertian(color(0.4, 0.2, 0.1)));
+  world.add_sphere(point3(4, 1, 0), 1.0, world.make_metal(color(0.7, 0.6, 0.5), 0.0));
+  if (with_light)
+    world.add_sphere(point3(2, 3, 2), 0.3, world.make_diffuse_light(color(15, 15, 15)));
+}
+
+// renders the whole image with kernel, returns the elapsed seconds and the mean pixel value
+static double render(scanline_kernel kernel, const scene_arena& world, const camera& cam, const render_config& config,
+                     color& mean)
+{
+  std::vector<color> scanline(config.width);
+  mean = color(0, 0, 0);
+  auto start = bench_clock::now();
+  for (int j = 0; j < config.height; ++j)
+  {
+    kernel(world, cam, config, j, 0, config.width, scanline.data());
+    for (const auto& pixel_color : scanline)
+      mean += pixel_color / config.samples_per_pixel;
+  }
+  mean /= config.width * config.height;
+  return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+  const int samples_per_pixel = argc > 1 ? std::stoi(argv[1]) : 8;
+  const int runs = argc > 2 ? std::stoi(argv[2]) : 5;
+  render_config config{ 160, 100, samples_per_pixel, 50 };
+
+  struct bench_case
+  {
+    const char* name;
+    double aperture;
+    bool with_light;
+  };
+  const bench_case cases[] = {
+    { "thin lens, no light", 0.1, false },
+    { "pinhole, no light", 0.0, false },
+    { "thin lens, light", 0.1, true },
+    { "pinhole, light", 0.0, true },
+  };
+
+  std::cout << config.width << "x" << config.height << ", " << samples_per_pixel << " spp, depth " << config.max_depth
+            << "\n";
+  for (const auto& c : cases)
+  {
+    scene_arena world;
+    spheres_scene(world, c.with_light);
+    camera cam(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, double(config.width) / config.height,
+               c.aperture, 10.0);
+
+    color generic_mean, static_mean;
+    auto generic_time = infinity;
+    auto static_time = infinity;
+    for (int run = 0; run < runs; run++)
+    {
+      generic_time = fmin(generic_time, render(&generic_scanline, world, cam, config, generic_mean));
+      static_time = fmin(static_time, render(select_kernel(world, cam, config), world, cam, config, static_mean));
+    }
+    std::cout << c.name << ":\n"
+              << "  generic      " << generic_time << " s  (mean " << generic_mean << ")\n"
+              << "  specialized  " << static_time << " s  (mean " << static_mean << ")\n"
+              << "  speedup      " << generic_time / static_time << "x\n";
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "material.hpp"
+#include "scene_arena.hpp"
+#include "integrator.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ *  Noise versus time for pure path sampling and for next-event estimation with MIS.
+ *  A scene lit by small emissive spheres is rendered with both integrators at increasing
+ *  sample counts, and every image is compared with a reference rendered with many samples.
+ *
+ *  usage: nee_bench [reference_spp]
+ */
+
+using bench_clock = std::chrono::steady_clock;
+
+const int image_width = 96;
+const int image_height = 64;
+const int max_depth = 10;
+
+static void small_lights_scene(scene_arena& world)
+{
+  world.add_sphere(point3(0, -1000, 0), 1000, world.make_lambertian(color(0.5, 0.5, 0.5)));
+  world.add_sphere(point3(-2, 1, 0), 1.0, world.make_lambertian(color(0.4, 0.2, 0.1)));
+  world.add_sphere(point3(0, 1, 0), 1.0, world.make_dielectric(1.5));
+  world.add_sphere(point3(2, 1, 0), 1.0, world.make_metal(color(0.7, 0.6, 0.5), 0.1));
+
+  auto light = world.make_diffuse_light(color(40, 40, 40));
+  world.add_sphere(point3(-1, 2.5, 1.5), 0.15, light);
+  world.add_sphere(point3(1.5, 3, -1), 0.15, light);
+}
+
+// renders the scene into a linear framebuffer (no gamma), returns the elapsed seconds
+static double render(const scene_arena& world, const camera& cam, bool nee, int samples_per_pixel,
+                     std::vector<color>& image)
+{
+  light_list no_lights;
+  const light_list& lights = nee ? world.lights() : no_lights;
+
+  image.assign(image_width * image_height, color(0, 0, 0));
+  auto start = bench_clock::now();
+  for (int j = 0; j < image_height; ++j)
+  {
+    for (int i = 0; i < image_width; ++i)
+    {
+      color pixel_color(0, 0, 0);
+      for (int s = 0; s < samples_per_pixel; ++s)
+      {
+        auto u = (i + random_double()) / (image_width - 1);
+        auto v = (j + random_double()) / (image_height - 1);
+        ray r = cam.get_ray(u, v);
+        if (nee)
+          pixel_color += ray_color(r, world, lights, max_depth);
+        else
+          pixel_color += ray_color(r, world, max_depth);
+      }
+      image[j * image_width + i] = pixel_color / samples_per_pixel;
+    }
+  }
+  return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// the value written to the image for a color channel, as in write_color
+static double displayed(double channel)
+{
+  return clamp(sqrt(channel), 0.0, 1.0);
+}
+
+// root mean square error over all the color channels of the displayed image
+static double rmse(const std::vector<color>& image, const std::vector<color>& reference)
+{
+  auto sum = 0.0;
+  for (std::size_t k = 0; k < image.size(); k++)
+    for (int c = 0; c < 3; c++)
+    {
+      auto d = displayed(image[k][c]) - displayed(reference[k][c]);
+      sum += d * d;
+    }
+  return sqrt(sum / (3.0 * image.size()));
+}
+
+int main(int argc, char** argv)
+{
+  const int reference_spp = argc > 1 ? std::stoi(argv[1]) : 1024;
+
+  scene_arena world;
+  small_lights_scene(world);
+
+  camera cam(point3(0, 3, 8), point3(0, 1, 0), vec3(0, 1, 0), 35, double(image_width) / image_height, 0.0, 8.0);
+
+  std::vector<color> reference;
+  auto reference_time = render(world, cam, true, reference_spp, reference);
+  std::cout << "reference: " << reference_spp << " spp with next-event estimation, " << reference_time << " s\n";
+  std::cout << "spp  path_time_s  path_rmse  nee_time_s  nee_rmse\n";
+
+  std::vector<color> image;
+  for (int spp = 1; spp <= 64; spp *= 4)
+  {
+    auto path_time = render(world, cam, false, spp, image);
+    auto path_error = rmse(image, reference);
+    auto nee_time = render(world, cam, true, spp, image);
+    auto nee_error = rmse(image, reference);
+    std::cout << spp << "  " << path_time << "  " << path_error << "  " << nee_time << "  " << nee_error << "\n";
+  }
+  return 0;
+}
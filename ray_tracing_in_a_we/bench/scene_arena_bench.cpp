@@ -0,0 +1,154 @@
+#include "rtweekend.hpp"
+
+#include "hittable_list.hpp"
+#include "sphere.hpp"
+#include "material.hpp"
+#include "scene_arena.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+/*
+ *  Compares the scene arena with the per-object make_shared layout.
+ *  For both layouts it reports the time to build and to tear down a scene of N spheres,
+ *  the resident memory used by the scene and the time to trace a few rays through it.
+ *
+ *  usage: scene_arena_bench [N] [rays]
+ */
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start)
+{
+  return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// resident set size of the process in bytes
+static std::size_t resident_bytes()
+{
+  long pages = 0, resident = 0;
+  FILE* f = std::fopen("/proc/self/statm", "r");
+  if (f)
+  {
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2)
+      resident = 0;
+    std::fclose(f);
+  }
+  return static_cast<std::size_t>(resident) * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// same random layout for both scenes: 80% diffuse, 15% metal, 5% glass
+struct sphere_desc
+{
+  point3 center;
+  double choose_mat;
+  color albedo;
+  double fuzz;
+};
+
+static sphere_desc random_sphere_desc()
+{
+  sphere_desc d;
+  d.center = vec3::random(-100, 100);
+  d.choose_mat = random_double();
+  d.albedo = color::random();
+  d.fuzz = random_double(0, 0.5);
+  return d;
+}
+
+static double trace(const hittable& world, const std::vector<ray>& rays)
+{
+  auto start = bench_clock::now();
+  int hits = 0;
+  hit_record rec;
+  for (const auto& r : rays)
+    if (world.hit(r, 0.001, infinity, rec))
+      hits++;
+  auto elapsed = seconds_since(start);
+  std::cerr << "  (" << hits << " hits)" << std::endl;
+  return elapsed;
+}
+
+static void report(const char* name, double build, std::size_t memory, double tracing, double teardown)
+{
+  std::cout << name << ":\n"
+            << "  build     " << build * 1e3 << " ms\n"
+            << "  memory    " << memory / (1024.0 * 1024.0) << " MiB\n"
+            << "  trace     " << tracing * 1e3 << " ms\n"
+            << "  teardown  " << teardown * 1e3 << " ms\n";
+}
+
+int main(int argc, char** argv)
+{
+  const std::size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  const std::size_t n_rays = argc > 2 ? std::stoul(argv[2]) : 200;
+
+  std::vector<sphere_desc> descs(n);
+  for (auto& d : descs)
+    d = random_sphere_desc();
+
+  std::vector<ray> rays(n_rays);
+  for (auto& r : rays)
+    r = ray(point3(0, 0, -200), vec3::random(-1, 1) + vec3(0, 0, 1));
+
+  std::cout << n << " spheres, " << n_rays << " rays" << std::endl;
+
+  // scene arena
+  {
+    auto rss = resident_bytes();
+    auto start = bench_clock::now();
+    auto* world = new scene_arena;
+    world->reserve(n);
+    for (const auto& d : descs)
+    {
+      const material* m;
+      if (d.choose_mat < 0.8)
+        m = world->make_lambertian(d.albedo);
+      else if (d.choose_mat < 0.95)
+        m = world->make_metal(d.albedo, d.fuzz);
+      else
+        m = world->make_dielectric(1.5);
+      world->add_sphere(d.center, 0.2, m);
+    }
+    auto build = seconds_since(start);
+    auto memory = resident_bytes() - rss;
+    auto tracing = trace(*world, rays);
+
+    start = bench_clock::now();
+    delete world;
+    report("scene_arena", build, memory, tracing, seconds_since(start));
+  }
+
+  // one make_shared per sphere and per material
+  {
+    auto rss = resident_bytes();
+    auto start = bench_clock::now();
+    auto* world = new hittable_list;
+    auto* materials = new std::vector<shared_ptr<material>>;
+    for (const auto& d : descs)
+    {
+      shared_ptr<material> m;
+      if (d.choose_mat < 0.8)
+        m = make_shared<lambertian>(d.albedo);
+      else if (d.choose_mat < 0.95)
+        m = make_shared<metal>(d.albedo, d.fuzz);
+      else
+        m = make_shared<dielectric>(1.5);
+      materials->push_back(m);
+      world->add(make_shared<sphere>(d.center, 0.2, m.get()));
+    }
+    auto build = seconds_since(start);
+    auto memory = resident_bytes() - rss;
+    auto tracing = trace(*world, rays);
+
+    start = bench_clock::now();
+    delete world;
+    delete materials;
+    report("make_shared", build, memory, tracing, seconds_since(start));
+  }
+
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "render_kernel.hpp"
+#include "scene_arena.hpp"
+#include "texture_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ *  Renders a scene of textured spheres through texture caches with smaller and smaller budgets
+ *  and reports the render time, the hit rate of the cache, its evictions and its resident bytes,
+ *  at the end and at most, against the budget.
+ *  The rows of the image are rendered by several threads, which share the cache.
+ *  The textures are generated in a temporary directory and removed at the end.
+ *
+ *  usage: texture_cache_bench [textures (16)] [texture size (1024)] [samples_per_pixel (4)] [threads]
+ */
+
+using bench_clock = std::chrono::steady_clock;
+
+// a colored checkerboard with a different color and square size for every texture
+static std::vector<unsigned char> checkerboard(int size, int seed)
+{
+  std::vector<unsigned char> rgb(3 * static_cast<std::size_t>(size) * size);
+  int square = 8 << (seed % 4);
+  for (int y = 0; y < size; y++)
+    for (int x = 0; x < size; x++)
+    {
+      bool dark = ((x / square) + (y / square)) % 2 == 0;
+      auto* texel = &rgb[3 * (static_cast<std::size_t>(y) * size + x)];
+      texel[0] = dark ? 40 : static_cast<unsigned char>(80 + 37 * seed % 170);
+      texel[1] = dark ? 40 : static_cast<unsigned char>(80 + 53 * seed % 170);
+      texel[2] = dark ? 40 : static_cast<unsigned char>(80 + 97 * seed % 170);
+    }
+  return rgb;
+}
+
+int main(int argc, char** argv)
+{
+  const int n_textures = argc > 1 ? std::stoi(argv[1]) : 16;
+  const int texture_size = argc > 2 ? std::stoi(argv[2]) : 1024;
+  const int samples_per_pixel = argc > 3 ? std::stoi(argv[3]) : 4;
+  // at least 4 threads, so that the lookups are concurrent even on a machine with few CPUs
+  const unsigned threads = argc > 4 ? std::stoi(argv[4]) : std::max(4u, std::thread::hardware_concurrency());
+
+  char directory[] = "/tmp/texture_cache_bench.XXXXXX";
+  if (!mkdtemp(directory))
+  {
+    std::cerr << "cannot create a temporary directory" << std::endl;
+    return 1;
+  }
+  std::vector<std::string> paths;
+  std::size_t pyramid_bytes = 0;
+  for (int t = 0; t < n_textures; t++)
+  {
+    std::string path = std::string(directory) + "/texture" + std::to_string(t) + ".rtt";
+    std::string error;
+    if (!write_tiled_texture(path, texture_size, texture_size, checkerboard(texture_size, t), 32, error))
+    {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+    paths.push_back(path);
+    // about 4/3 of the full resolution level
+    pyramid_bytes += 4 * 3 * static_cast<std::size_t>(texture_size) * texture_size / 3;
+  }
+  std::cout << n_textures << " textures of " << texture_size << "x" << texture_size << ", "
+            << pyramid_bytes / (1024.0 * 1024.0) << " MiB of MIP pyramids, " << threads << " threads\n";
+
+  const render_config config{ 400, 225, samples_per_pixel, 10 };
+  camera cam(point3(0, 3, 12), point3(0, 0.5, 0), vec3(0, 1, 0), 30, double(config.width) / config.height, 0, 12);
+
+  for (int divisor : { 1, 4, 16, 64 })
+  {
+    texture_cache cache(pyramid_bytes / divisor);
+    scene_arena world;
+    std::vector<const texture*> textures;
+    for (const auto& path : paths)
+    {
+      std::string error;
+      const tiled_texture* file = cache.open(path, error);
+      if (!file)
+      {
+        std::cerr << error << std::endl;
+        return 1;
+      }
+      textures.push_back(world.make_image_texture(cache, *file));
+    }
+
+    // a textured ground and a grid of textured spheres, a few of them metallic
+    world.add_sphere(point3(0, -1000, 0), 1000, world.make_lambertian(textures[0]));
+    int k = 0;
+    for (int a = -4; a <= 4; a++)
+      for (int b = -4; b <= 2; b++, k++)
+      {
+        const texture* t = textures[k % n_textures];
+        const material* m = k % 5 == 0 ? static_cast<const material*>(world.make_metal(t, 0.2))
+                                       : static_cast<const material*>(world.make_lambertian(t));
+        world.add_sphere(point3(1.2 * a, 0.5, 1.2 * b), 0.5, m);
+      }
+    world.build_bvh();
+
+    scanline_kernel kernel = select_kernel(world, cam, config);
+    std::vector<color> image(config.width * config.height);
+    auto start = bench_clock::now();
+    std::atomic<int> next_row(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+      workers.emplace_back([&] {
+        int j;
+        while ((j = next_row++) < config.height)
+          kernel(world, cam, config, j, 0, config.width, &image[j * config.width]);
+      });
+    for (auto& worker : workers)
+      worker.join();
+    auto seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    color mean(0, 0, 0);
+    for (const auto& pixel_color : image)
+      mean += pixel_color / (double(samples_per_pixel) * image.size());
+    auto stats = cache.stats();
+    std::cout << "budget 1/" << divisor << ": " << seconds
+              << " s, hit rate " << 100 * stats.hit_rate() << "%, " << stats.misses << " tiles read, "
+              << stats.evictions << " evicted, " << stats.resident_bytes / (1024.0 * 1024.0) << " MiB resident ("
+              << stats.peak_resident_bytes / (1024.0 * 1024.0) << " MiB at most) of the "
+              << stats.budget_bytes / (1024.0 * 1024.0) << " MiB budget (mean " << mean << ")\n";
+  }
+
+  for (const auto& path : paths)
+    std::remove(path.c_str());
+  std::remove(directory);
+  return 0;
+}
@@ -0,0 +1,103 @@
+#ifndef INCLUDE_AABB_HPP_
+#define INCLUDE_AABB_HPP_
+
+#include "rtweekend.hpp"
+
+#include <utility>
+
+// axis-aligned bounding box
+class aabb
+{
+public:
+  // the default box is empty: it contains no point and adding any box to it gives that box
+  aabb() : minimum(infinity, infinity, infinity), maximum(-infinity, -infinity, -infinity)
+  {
+  }
+  aabb(const point3& a, const point3& b) : minimum(a), maximum(b)
+  {
+  }
+
+  point3 min() const
+  {
+    return minimum;
+  }
+  point3 max() const
+  {
+    return maximum;
+  }
+
+  point3 centroid() const
+  {
+    return 0.5 * (minimum + maximum);
+  }
+
+  // half of the surface area, which is all the SAH needs
+  double half_area() const
+  {
+    vec3 d = maximum - minimum;
+    if (d.x() < 0)
+      return 0;
+    return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+  }
+
+  int longest_axis() const
+  {
+    vec3 d = maximum - minimum;
+    if (d.x() > d.y() && d.x() > d.z())
+      return 0;
+    return d.y() > d.z() ? 1 : 2;
+  }
+
+  void extend(const point3& p)
+  {
+    for (int a = 0; a < 3; a++)
+    {
+      minimum[a] = fmin(minimum[a], p[a]);
+      maximum[a] = fmax(maximum[a], p[a]);
+    }
+  }
+
+  void extend(const aabb& box)
+  {
+    for (int a = 0; a < 3; a++)
+    {
+      minimum[a] = fmin(minimum[a], box.minimum[a]);
+      maximum[a] = fmax(maximum[a], box.maximum[a]);
+    }
+  }
+
+  // slab test; inv_direction holds 1 / r.direction() for each axis
+  inline bool hit(const point3& origin, const vec3& inv_direction, double t_min, double t_max) const
+  {
+    for (int a = 0; a < 3; a++)
+    {
+      auto t0 = (minimum[a] - origin[a]) * inv_direction[a];
+      auto t1 = (maximum[a] - origin[a]) * inv_direction[a];
+      if (inv_direction[a] < 0)
+        std::swap(t0, t1);
+      t_min = t0 > t_min ? t0 : t_min;
+      t_max = t1 < t_max ? t1 : t_max;
+      if (t_max < t_min)
+        return false;
+    }
+    return true;
+  }
+
+  bool hit(const ray& r, double t_min, double t_max) const
+  {
+    vec3 d = r.direction();
+    return hit(r.origin(), vec3(1 / d.x(), 1 / d.y(), 1 / d.z()), t_min, t_max);
+  }
+
+public:
+  point3 minimum;
+  point3 maximum;
+};
+
+inline aabb surrounding_box(aabb box0, const aabb& box1)
+{
+  box0.extend(box1);
+  return box0;
+}
+
+#endif /* INCLUDE_AABB_HPP_ */
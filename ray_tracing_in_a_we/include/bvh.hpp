@@ -0,0 +1,729 @@
+#ifndef INCLUDE_BVH_HPP_
+#define INCLUDE_BVH_HPP_
+
+#include "rtweekend.hpp"
+
+#include "aabb.hpp"
+#include "hittable.hpp"
+#include "sphere.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ *  Bounding volume hierarchy over spheres, stored as a flat array of nodes in depth-first order.
+ *
+ *  fast       linear BVH: the primitives are sorted along a Morton curve with a parallel radix sort
+ *             and the hierarchy is the binary radix tree of the sorted codes (Karras 2012), built,
+ *             bounded and flattened in parallel.
+ *  balanced   the linear BVH, whose top levels are rebuilt with the surface area heuristic (SAH)
+ *             over its sah_clusters largest subtrees.
+ *  reference  serial top-down build with a binned SAH, slow to build but the best to trace.
+ */
+
+enum class bvh_quality
+{
+  fast,
+  balanced,
+  reference
+};
+
+struct bvh_options
+{
+  bvh_quality quality = bvh_quality::balanced;
+  int max_leaf_size = 4;
+  // number of linear BVH subtrees rearranged by the SAH in a balanced build
+  int sah_clusters = 1024;
+  unsigned threads = std::thread::hardware_concurrency();
+};
+
+struct bvh_node
+{
+  aabb box;
+  int offset;  // leaf: first primitive; interior: second child, the first one follows the node
+  int count;   // leaf: number of primitives; interior: 0
+  int axis;    // interior: the first child comes first along this axis
+};
+
+// a sphere stored in a leaf, without the vtable pointer of a sphere object
+struct bvh_primitive
+{
+  point3 center;
+  double radius;
+  const material* mat_ptr;
+
+  aabb bounds() const
+  {
+    vec3 extent(radius, radius, radius);
+    return aabb(center - extent, center + extent);
+  }
+};
+
+class bvh : public hittable
+{
+public:
+  // the spheres are copied, as bvh_primitive, in the order of the leaves; their materials must outlive the bvh
+  bvh(const std::vector<const sphere*>& objects, const bvh_options& options = bvh_options());
+
+  virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+  virtual bool occluded(const ray& r, double t_min, double t_max) const override;
+  virtual bool bounding_box(aabb& output_box) const override;
+
+  // expected cost of a random ray, counting 1 per node visit and per sphere test
+  double sah_cost() const;
+
+  std::size_t bytes() const
+  {
+    return nodes.size() * sizeof(bvh_node) + primitives.size() * sizeof(bvh_primitive);
+  }
+
+public:
+  const bvh_options options;
+  std::vector<bvh_node> nodes;
+  std::vector<bvh_primitive> primitives;
+
+private:
+  // the traversal stack never needs more entries than the depth of the tree, which is bounded by the
+  // key bits of the radix tree (96) plus the depth of the SAH levels (see max_sah_depth)
+  static const int stack_size = 256;
+  // below this depth the SAH splits at the median, so that the SAH levels stay shallow
+  static const int max_sah_depth = 64;
+
+  void build_linear(const std::vector<const sphere*>& objects);
+  void build_reference(const std::vector<const sphere*>& objects);
+};
+
+namespace bvh_build
+{
+// spreads the 21 low bits of v so that there are two zero bits between each of them
+inline std::uint64_t expand_bits(std::uint64_t v)
+{
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+// 63 bit Morton code of a point of the unit cube
+inline std::uint64_t morton_code(const vec3& p)
+{
+  const double scale = 1 << 21;
+  std::uint64_t code = 0;
+  for (int a = 0; a < 3; a++)
+  {
+    auto q = static_cast<std::uint64_t>(clamp(p[a] * scale, 0.0, scale - 1));
+    code |= expand_bits(q) << (2 - a);
+  }
+  return code;
+}
+
+struct morton_entry
+{
+  std::uint64_t code;
+  std::uint32_t index;
+};
+
+// stable least significant digit radix sort on the codes, 8 bits per pass, each pass in parallel
+inline void radix_sort(std::vector<morton_entry>& entries, unsigned threads)
+{
+  const std::size_t n = entries.size();
+  std::vector<morton_entry> buffer(n);
+  std::vector<std::array<std::size_t, 256>> offsets(threads);
+
+  for (int shift = 0; shift < 64; shift += 8)
+  {
+    parallel_for(n, threads, [&](unsigned c, std::size_t begin, std::size_t end) {
+      offsets[c].fill(0);
+      for (std::size_t i = begin; i < end; i++)
+        offsets[c][(entries[i].code >> shift) & 0xff]++;
+    });
+
+    // a digit shared by every key does not need a pass
+    bool skip = false;
+    std::size_t sum = 0;
+    for (int digit = 0; digit < 256; digit++)
+    {
+      std::size_t digit_count = 0;
+      for (unsigned c = 0; c < threads; c++)
+      {
+        auto count = offsets[c][digit];
+        offsets[c][digit] = sum;
+        sum += count;
+        digit_count += count;
+      }
+      if (digit_count == n)
+        skip = true;
+    }
+    if (skip)
+      continue;
+
+    parallel_for(n, threads, [&](unsigned c, std::size_t begin, std::size_t end) {
+      auto& offset = offsets[c];
+      for (std::size_t i = begin; i < end; i++)
+        buffer[offset[(entries[i].code >> shift) & 0xff]++] = entries[i];
+    });
+    entries.swap(buffer);
+  }
+}
+
+// a sphere seen by the SAH
+struct primitive_item
+{
+  const sphere* s;
+
+  aabb bounds() const
+  {
+    aabb box;
+    s->sphere::bounding_box(box);
+    return box;
+  }
+  point3 center() const
+  {
+    return s->center;
+  }
+};
+
+// a subtree of the linear BVH seen by the SAH
+struct cluster_item
+{
+  int node;
+  int flat_size;
+  aabb box;
+
+  aabb bounds() const
+  {
+    return box;
+  }
+  point3 center() const
+  {
+    return box.centroid();
+  }
+};
+
+/*
+ *  Splits items [begin, end) in two non-empty groups with a binned SAH along the longest axis of
+ *  the centroids and returns the start of the second group. The split is at the median when the
+ *  centroids cannot be told apart or when median_split is set.
+ */
+template <typename Item>
+std::size_t sah_partition(std::vector<Item>& items, std::size_t begin, std::size_t end, bool median_split, int& axis)
+{
+  const int n_bins = 16;
+  aabb centroid_bounds;
+  for (std::size_t i = begin; i < end; i++)
+    centroid_bounds.extend(items[i].center());
+  axis = centroid_bounds.longest_axis();
+
+  std::size_t mid = begin + (end - begin) / 2;
+  auto low = centroid_bounds.min()[axis];
+  auto extent = centroid_bounds.max()[axis] - low;
+  if (extent <= 0)
+    return mid;
+  if (median_split)
+  {
+    std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+                     [axis](const Item& a, const Item& b) { return a.center()[axis] < b.center()[axis]; });
+    return mid;
+  }
+
+  auto bin_of = [&](const Item& item) {
+    auto b = static_cast<int>(n_bins * (item.center()[axis] - low) / extent);
+    return b < n_bins ? b : n_bins - 1;
+  };
+
+  aabb bin_box[n_bins];
+  std::size_t bin_count[n_bins] = {};
+  for (std::size_t i = begin; i < end; i++)
+  {
+    auto b = bin_of(items[i]);
+    bin_count[b]++;
+    bin_box[b].extend(items[i].bounds());
+  }
+
+  // area and count of the bins [b, n_bins)
+  double right_area[n_bins];
+  std::size_t right_count[n_bins];
+  aabb box;
+  std::size_t count = 0;
+  for (int b = n_bins - 1; b > 0; b--)
+  {
+    box.extend(bin_box[b]);
+    count += bin_count[b];
+    right_area[b] = box.half_area();
+    right_count[b] = count;
+  }
+
+  int best_split = -1;
+  auto best_cost = infinity;
+  box = aabb();
+  count = 0;
+  for (int b = 1; b < n_bins; b++)
+  {
+    box.extend(bin_box[b - 1]);
+    count += bin_count[b - 1];
+    auto cost = count * box.half_area() + right_count[b] * right_area[b];
+    if (count > 0 && right_count[b] > 0 && cost < best_cost)
+    {
+      best_cost = cost;
+      best_split = b;
+    }
+  }
+  if (best_split < 0)
+    return mid;
+
+  auto second = std::partition(items.begin() + begin, items.begin() + end,
+                               [&](const Item& item) { return bin_of(item) < best_split; });
+  return second - items.begin();
+}
+}  // namespace bvh_build
+
+bvh::bvh(const std::vector<const sphere*>& objects, const bvh_options& options) : options(options)
+{
+  if (objects.empty())
+    return;
+  if (options.quality == bvh_quality::reference)
+    build_reference(objects);
+  else
+    build_linear(objects);
+}
+
+void bvh::build_linear(const std::vector<const sphere*>& objects)
+{
+  using namespace bvh_build;
+  const unsigned threads = options.threads ? options.threads : 1;
+  const int n = static_cast<int>(objects.size());
+  const int max_leaf = options.max_leaf_size > 0 ? options.max_leaf_size : 1;
+
+  // Morton codes of the centroids, in the cube that bounds them
+  std::vector<aabb> chunk_bounds(threads);
+  parallel_for(n, threads, [&](unsigned c, std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++)
+      chunk_bounds[c].extend(objects[i]->center);
+  });
+  aabb centroid_bounds;
+  for (const auto& box : chunk_bounds)
+    centroid_bounds.extend(box);
+  vec3 extent = centroid_bounds.max() - centroid_bounds.min();
+  auto cube_size = fmax(fmax(extent.x(), extent.y()), fmax(extent.z(), 1e-12));
+
+  std::vector<morton_entry> entries(n);
+  parallel_for(n, threads, [&](unsigned, std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++)
+    {
+      entries[i].code = morton_code((objects[i]->center - centroid_bounds.min()) / cube_size);
+      entries[i].index = static_cast<std::uint32_t>(i);
+    }
+  });
+  radix_sort(entries, threads);
+
+  primitives.resize(n);
+  parallel_for(n, threads, [&](unsigned, std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++)
+    {
+      const sphere* s = objects[entries[i].index];
+      primitives[i] = bvh_primitive{ s->center, s->radius, s->mat_ptr };
+    }
+  });
+
+  if (n <= max_leaf)
+  {
+    bvh_node leaf;
+    for (const auto& p : primitives)
+      leaf.box.extend(p.bounds());
+    leaf.offset = 0;
+    leaf.count = n;
+    leaf.axis = 0;
+    nodes.push_back(leaf);
+    return;
+  }
+
+  /*
+   *  Binary radix tree: n - 1 internal nodes, node 0 is the root. A child c >= 0 is an internal node,
+   *  c < 0 is the leaf holding the primitive ~c. Every node covers a contiguous range of primitives.
+   */
+  const int n_internal = n - 1;
+  std::vector<int> left(n_internal), right(n_internal), first(n_internal), last(n_internal);
+  std::vector<int> parent_internal(n_internal, -1), parent_leaf(n);
+
+  // length of the common prefix of the keys i and j, ties broken by the index
+  auto delta = [&](int i, int j) {
+    if (j < 0 || j >= n)
+      return -1;
+    auto a = entries[i].code, b = entries[j].code;
+    if (a == b)
+      return 64 + __builtin_clz(static_cast<unsigned>(i ^ j));
+    return __builtin_clzll(a ^ b);
+  };
+
+  parallel_for(n_internal, threads, [&](unsigned, std::size_t begin, std::size_t end) {
+    for (int i = static_cast<int>(begin); i < static_cast<int>(end); i++)
+    {
+      // direction of the range and its other end
+      int d = delta(i, i + 1) - delta(i, i - 1) > 0 ? 1 : -1;
+      int delta_min = delta(i, i - d);
+      int l_max = 2;
+      while (delta(i, i + l_max * d) > delta_min)
+        l_max *= 2;
+      int l = 0;
+      for (int t = l_max / 2; t >= 1; t /= 2)
+        if (delta(i, i + (l + t) * d) > delta_min)
+          l += t;
+      int j = i + l * d;
+
+      // split position
+      int delta_node = delta(i, j);
+      int s = 0;
+      int step = l;
+      do
+      {
+        step = (step + 1) / 2;
+        if (delta(i, i + (s + step) * d) > delta_node)
+          s += step;
+      } while (step > 1);
+      int gamma = i + s * d + (d < 0 ? -1 : 0);
+
+      first[i] = std::min(i, j);
+      last[i] = std::max(i, j);
+      left[i] = first[i] == gamma ? ~gamma : gamma;
+      right[i] = last[i] == gamma + 1 ? ~(gamma + 1) : gamma + 1;
+      if (left[i] < 0)
+        parent_leaf[gamma] = i;
+      else
+        parent_internal[gamma] = i;
+      if (right[i] < 0)
+        parent_leaf[gamma + 1] = i;
+      else
+        parent_internal[gamma + 1] = i;
+    }
+  });
+
+  auto count_of = [&](int c) { return c < 0 ? 1 : last[c] - first[c] + 1; };
+  auto first_of = [&](int c) { return c < 0 ? ~c : first[c]; };
+
+  // boxes and flattened sizes, bottom-up: the second child to arrive at a node computes it
+  std::vector<aabb> box(n_internal);
+  std::vector<int> flat_size(n_internal);
+  std::unique_ptr<std::atomic<int>[]> arrivals(new std::atomic<int>[n_internal]);
+  for (int i = 0; i < n_internal; i++)
+    arrivals[i] = 0;
+
+  auto box_of = [&](int c) {
+    return c >= 0 ? box[c] : primitives[~c].bounds();
+  };
+  auto flat_size_of = [&](int c) { return c < 0 ? 1 : flat_size[c]; };
+
+  // the children of c along the axis that separates their centers the most, nearest to the origin first
+  auto order_children = [&](int c, int& near_child, int& far_child) {
+    vec3 d = box_of(right[c]).centroid() - box_of(left[c]).centroid();
+    int axis = fabs(d.x()) > fabs(d.y()) && fabs(d.x()) > fabs(d.z()) ? 0 : (fabs(d.y()) > fabs(d.z()) ? 1 : 2);
+    near_child = d[axis] >= 0 ? left[c] : right[c];
+    far_child = d[axis] >= 0 ? right[c] : left[c];
+    return axis;
+  };
+
+  parallel_for(n, threads, [&](unsigned, std::size_t begin, std::size_t end) {
+    for (int k = static_cast<int>(begin); k < static_cast<int>(end); k++)
+    {
+      int p = parent_leaf[k];
+      while (p >= 0 && arrivals[p].fetch_add(1, std::memory_order_acq_rel) == 1)
+      {
+        box[p] = surrounding_box(box_of(left[p]), box_of(right[p]));
+        flat_size[p] = count_of(p) <= max_leaf ? 1 : 1 + flat_size_of(left[p]) + flat_size_of(right[p]);
+        p = parent_internal[p];
+      }
+    }
+  });
+
+  // writes the subtree of c at dest, a node with few primitives becomes a single leaf
+  std::function<void(int, int)> emit = [&](int c, int dest) {
+    bvh_node& node = nodes[dest];
+    node.box = box_of(c);
+    if (count_of(c) <= max_leaf)
+    {
+      node.offset = first_of(c);
+      node.count = count_of(c);
+      node.axis = 0;
+      return;
+    }
+    int near_child, far_child;
+    node.axis = order_children(c, near_child, far_child);
+    node.offset = dest + 1 + flat_size_of(near_child);
+    node.count = 0;
+    emit(near_child, dest + 1);
+    emit(far_child, node.offset);
+  };
+
+  // the largest subtrees, split from the root until there are enough of them
+  const int target = options.quality == bvh_quality::balanced ? std::max(options.sah_clusters, 1)
+                                                              : static_cast<int>(threads) * 16;
+  std::vector<int> clusters;
+  {
+    std::priority_queue<std::pair<int, int>> largest;
+    largest.push(std::make_pair(count_of(0), 0));
+    while (!largest.empty() && static_cast<int>(largest.size() + clusters.size()) < target)
+    {
+      int c = largest.top().second;
+      largest.pop();
+      if (count_of(c) <= max_leaf)
+      {
+        clusters.push_back(c);
+        continue;
+      }
+      largest.push(std::make_pair(count_of(left[c]), left[c]));
+      largest.push(std::make_pair(count_of(right[c]), right[c]));
+    }
+    while (!largest.empty())
+    {
+      clusters.push_back(largest.top().second);
+      largest.pop();
+    }
+  }
+
+  // the top of the tree is written serially, the subtrees below it in parallel
+  std::vector<std::pair<int, int>> subtrees;
+
+  if (options.quality == bvh_quality::balanced)
+  {
+    // SAH over the clusters; a full binary tree over k clusters has k - 1 interior nodes
+    std::vector<cluster_item> items;
+    int total = -1;
+    for (int c : clusters)
+    {
+      items.push_back(cluster_item{ c, flat_size_of(c), box_of(c) });
+      total += 1 + flat_size_of(c);
+    }
+    nodes.resize(total);
+
+    std::function<int(std::size_t, std::size_t, int, int)> emit_top = [&](std::size_t begin, std::size_t end,
+                                                                          int dest, int depth) {
+      if (end - begin == 1)
+      {
+        subtrees.push_back(std::make_pair(items[begin].node, dest));
+        return items[begin].flat_size;
+      }
+      int axis;
+      auto mid = sah_partition(items, begin, end, depth >= max_sah_depth, axis);
+      int left_size = static_cast<int>(mid - begin) - 1;
+      aabb bounds;
+      for (std::size_t i = begin; i < end; i++)
+      {
+        bounds.extend(items[i].box);
+        if (i < mid)
+          left_size += items[i].flat_size;
+      }
+      nodes[dest].box = bounds;
+      nodes[dest].offset = dest + 1 + left_size;
+      nodes[dest].count = 0;
+      nodes[dest].axis = axis;
+      emit_top(begin, mid, dest + 1, depth + 1);
+      return 1 + left_size + emit_top(mid, end, dest + 1 + left_size, depth + 1);
+    };
+    emit_top(0, items.size(), 0, 0);
+  }
+  else
+  {
+    nodes.resize(flat_size_of(0));
+    std::vector<char> is_cluster(n_internal, 0);
+    for (int c : clusters)
+      if (c >= 0)
+        is_cluster[c] = 1;
+
+    std::function<void(int, int)> emit_top = [&](int c, int dest) {
+      if (c < 0 || count_of(c) <= max_leaf || is_cluster[c])
+      {
+        subtrees.push_back(std::make_pair(c, dest));
+        return;
+      }
+      int near_child, far_child;
+      nodes[dest].box = box[c];
+      nodes[dest].axis = order_children(c, near_child, far_child);
+      nodes[dest].offset = dest + 1 + flat_size_of(near_child);
+      nodes[dest].count = 0;
+      emit_top(near_child, dest + 1);
+      emit_top(far_child, nodes[dest].offset);
+    };
+    emit_top(0, 0);
+  }
+
+  // largest subtrees first, so that the threads finish together
+  std::sort(subtrees.begin(), subtrees.end(), [&](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+    return flat_size_of(a.first) > flat_size_of(b.first);
+  });
+  std::atomic<std::size_t> next_subtree(0);
+  auto fill = [&] {
+    std::size_t i;
+    while ((i = next_subtree++) < subtrees.size())
+      emit(subtrees[i].first, subtrees[i].second);
+  };
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < threads && n >= 4096; t++)
+    workers.emplace_back(fill);
+  fill();
+  for (auto& worker : workers)
+    worker.join();
+}
+
+void bvh::build_reference(const std::vector<const sphere*>& objects)
+{
+  using namespace bvh_build;
+  const std::size_t max_leaf = options.max_leaf_size > 0 ? options.max_leaf_size : 1;
+
+  std::vector<primitive_item> items(objects.size());
+  for (std::size_t i = 0; i < objects.size(); i++)
+    items[i].s = objects[i];
+
+  std::function<int(std::size_t, std::size_t, int)> build = [&](std::size_t begin, std::size_t end, int depth) {
+    int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    aabb bounds;
+    for (std::size_t i = begin; i < end; i++)
+      bounds.extend(items[i].bounds());
+    nodes[index].box = bounds;
+
+    if (end - begin <= max_leaf)
+    {
+      nodes[index].offset = static_cast<int>(begin);
+      nodes[index].count = static_cast<int>(end - begin);
+      nodes[index].axis = 0;
+      return index;
+    }
+
+    int axis;
+    auto mid = sah_partition(items, begin, end, depth >= max_sah_depth, axis);
+    build(begin, mid, depth + 1);
+    int second = build(mid, end, depth + 1);
+    nodes[index].offset = second;
+    nodes[index].count = 0;
+    nodes[index].axis = axis;
+    return index;
+  };
+  nodes.reserve(2 * objects.size() / max_leaf + 1);
+  build(0, items.size(), 0);
+
+  primitives.reserve(items.size());
+  for (const auto& item : items)
+    primitives.push_back(bvh_primitive{ item.s->center, item.s->radius, item.s->mat_ptr });
+}
+
+bool bvh::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
+{
+  if (nodes.empty())
+    return false;
+
+  vec3 d = r.direction();
+  vec3 inv_direction(1 / d.x(), 1 / d.y(), 1 / d.z());
+  bool negative[3] = { inv_direction.x() < 0, inv_direction.y() < 0, inv_direction.z() < 0 };
+
+  int stack[stack_size];
+  int top = 0;
+  int current = 0;
+  bool hit_anything = false;
+  auto closest_so_far = t_max;
+
+  while (true)
+  {
+    const bvh_node& node = nodes[current];
+    if (node.box.hit(r.origin(), inv_direction, t_min, closest_so_far))
+    {
+      if (node.count > 0)
+      {
+        for (int i = node.offset; i < node.offset + node.count; i++)
+        {
+          const bvh_primitive& p = primitives[i];
+          if (sphere::hit_sphere(p.center, p.radius, p.mat_ptr, r, t_min, closest_so_far, rec))
+          {
+            hit_anything = true;
+            closest_so_far = rec.t;
+          }
+        }
+      }
+      else
+      {
+        // visit first the child that comes first along the ray
+        if (negative[node.axis])
+        {
+          stack[top++] = current + 1;
+          current = node.offset;
+        }
+        else
+        {
+          stack[top++] = node.offset;
+          current = current + 1;
+        }
+        continue;
+      }
+    }
+    if (top == 0)
+      break;
+    current = stack[--top];
+  }
+  return hit_anything;
+}
+
+bool bvh::occluded(const ray& r, double t_min, double t_max) const
+{
+  if (nodes.empty())
+    return false;
+
+  vec3 d = r.direction();
+  vec3 inv_direction(1 / d.x(), 1 / d.y(), 1 / d.z());
+
+  int stack[stack_size];
+  int top = 0;
+  int current = 0;
+
+  while (true)
+  {
+    const bvh_node& node = nodes[current];
+    if (node.box.hit(r.origin(), inv_direction, t_min, t_max))
+    {
+      if (node.count > 0)
+      {
+        for (int i = node.offset; i < node.offset + node.count; i++)
+          if (sphere::occluded_by_sphere(primitives[i].center, primitives[i].radius, r, t_min, t_max))
+            return true;
+      }
+      else
+      {
+        stack[top++] = node.offset;
+        current = current + 1;
+        continue;
+      }
+    }
+    if (top == 0)
+      return false;
+    current = stack[--top];
+  }
+}
+
+bool bvh::bounding_box(aabb& output_box) const
+{
+  if (nodes.empty())
+    return false;
+  output_box = nodes[0].box;
+  return true;
+}
+
+double bvh::sah_cost() const
+{
+  if (nodes.empty())
+    return 0;
+  auto cost = 0.0;
+  for (const auto& node : nodes)
+    cost += node.box.half_area() * (node.count > 0 ? 1 + node.count : 1);
+  return cost / nodes[0].box.half_area();
+}
+
+#endif /* INCLUDE_BVH_HPP_ */
@@ -45,6 +45,13 @@ public:
     lower_left_corner =
         origin - horizontal / 2 - vertical / 2 - focus_dist * w;  // lower left corner of the projection plane
     lens_radius = aperture / 2;
+    unit_viewport_height = viewport_height;
+  }
+
+  // the spread of the rays through the pixels of an image of the given height
+  double pixel_spread(int image_height) const
+  {
+    return unit_viewport_height / image_height;
   }
 
   ray get_ray(double s, double t) const
@@ -54,6 +61,22 @@ public:
     return ray(origin + offset, lower_left_corner + s * horizontal + t * vertical - origin - offset);
   }
 
+  // get_ray for a camera known at compile time to have (ThinLens) or not to have a lens.
+  // A pinhole camera does not draw a point on the lens.
+  template <bool ThinLens>
+  ray sample_ray(double s, double t) const
+  {
+    if constexpr (ThinLens)
+      return get_ray(s, t);
+    else
+      return ray(origin, lower_left_corner + s * horizontal + t * vertical - origin);
+  }
+
+  bool is_pinhole() const
+  {
+    return lens_radius == 0;
+  }
+
 private:
   point3 origin;
   point3 lower_left_corner;
@@ -61,6 +84,7 @@ private:
   vec3 vertical;
   vec3 u, v, w;
   double lens_radius;
+  double unit_viewport_height;
 };
 
 #endif /* INCLUDE_CAMERA_HPP_ */
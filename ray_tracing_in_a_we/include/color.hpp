@@ -4,7 +4,8 @@
 #include "vec3.hpp"
 #include <iostream>
 
-void write_color(std::ostream& out, color pixel_color, int samples_per_pixel)
+// Stores the [0,255] values of the averaged and gamma-corrected pixel_color in out[0..2].
+void color_to_bytes(unsigned char* out, color pixel_color, int samples_per_pixel)
 {
   auto r = pixel_color.x();
   auto g = pixel_color.y();
@@ -16,9 +17,19 @@ void write_color(std::ostream& out, color pixel_color, int samples_per_pixel)
   g = sqrt(g * scale);
   b = sqrt(b * scale);
 
+  // Translate each color component to [0,255].
+  out[0] = static_cast<unsigned char>(256 * clamp(r, 0.0, 0.999));
+  out[1] = static_cast<unsigned char>(256 * clamp(g, 0.0, 0.999));
+  out[2] = static_cast<unsigned char>(256 * clamp(b, 0.0, 0.999));
+}
+
+void write_color(std::ostream& out, color pixel_color, int samples_per_pixel)
+{
+  unsigned char rgb[3];
+  color_to_bytes(rgb, pixel_color, samples_per_pixel);
+
   // Write the translated [0,255] value of each color component.
-  out << static_cast<int>(256 * clamp(r, 0.0, 0.999)) << ' ' << static_cast<int>(256 * clamp(g, 0.0, 0.999)) << ' '
-      << static_cast<int>(256 * clamp(b, 0.0, 0.999)) << '\n';
+  out << static_cast<int>(rgb[0]) << ' ' << static_cast<int>(rgb[1]) << ' ' << static_cast<int>(rgb[2]) << '\n';
 }
 
 #endif /* INCLUDE_COLOR_HPP_ */
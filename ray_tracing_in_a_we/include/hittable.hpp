@@ -1,6 +1,7 @@
 #ifndef INCLUDE_HITTABLE_HPP_
 #define INCLUDE_HITTABLE_HPP_
 
+#include "aabb.hpp"
 #include "ray.hpp"
 #include "rtweekend.hpp"
 
@@ -12,10 +13,15 @@ struct hit_record
   point3 p;
   // the normal vector at the point of intersection
   vec3 normal;
-  // the material of the object that was hit
-  shared_ptr<material> mat_ptr;
+  // the material of the object that was hit (not owned)
+  const material* mat_ptr;
   // the distance from the ray origin to the point of intersection
   double t;
+  // the surface coordinates of p, in [0, 1]
+  double u;
+  double v;
+  // the width of the ray footprint at p, in uv units
+  double footprint;
   bool front_face;
 
   inline void set_face_normal(const ray& r, const vec3& outward_normal)
@@ -28,8 +34,21 @@ struct hit_record
 class hittable
 {
 public:
+  virtual ~hittable() = default;
+
   // the hit function returns true if the ray hits the object
   virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+
+  // the occluded function returns true if the ray hits anything in [t_min, t_max].
+  // It does not look for the closest hit, so implementations can stop at the first one.
+  virtual bool occluded(const ray& r, double t_min, double t_max) const
+  {
+    hit_record rec;
+    return hit(r, t_min, t_max, rec);
+  }
+
+  // the bounding_box function returns false if the object has no bounding box
+  virtual bool bounding_box(aabb& output_box) const = 0;
 };
 
 #endif /* INCLUDE_HITTABLE_HPP_ */
@@ -29,6 +29,8 @@ public:
   }
 
   virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+  virtual bool occluded(const ray& r, double t_min, double t_max) const override;
+  virtual bool bounding_box(aabb& output_box) const override;
 
 public:
   std::vector<shared_ptr<hittable>> objects;
@@ -60,4 +62,31 @@ bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& re
   return hit_anything;
 }
 
+bool hittable_list::occluded(const ray& r, double t_min, double t_max) const
+{
+  // any hit is enough, there is no need to find the closest one
+  for (const auto& object : objects)
+  {
+    if (object->occluded(r, t_min, t_max))
+      return true;
+  }
+  return false;
+}
+
+bool hittable_list::bounding_box(aabb& output_box) const
+{
+  if (objects.empty())
+    return false;
+
+  output_box = aabb();
+  aabb temp_box;
+  for (const auto& object : objects)
+  {
+    if (!object->bounding_box(temp_box))
+      return false;
+    output_box.extend(temp_box);
+  }
+  return true;
+}
+
 #endif /* INCLUDE_HITTABLE_LIST_HPP_ */
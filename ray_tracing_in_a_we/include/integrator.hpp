@@ -0,0 +1,111 @@
+#ifndef INCLUDE_INTEGRATOR_HPP_
+#define INCLUDE_INTEGRATOR_HPP_
+
+#include "rtweekend.hpp"
+
+#include "hittable.hpp"
+#include "light_list.hpp"
+#include "material.hpp"
+
+// the color of the sky seen along the ray r
+inline color sky_color(const ray& r)
+{
+  // we take the unit vector of the ray's direction
+  vec3 unit_direction = unit_vector(r.direction());
+  // we map the y coordinate of the unit vector to the range [0,1]
+  auto t = 0.5 * (unit_direction.y() + 1.0);
+  // we linearly interpolate between white and blue
+  return (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+}
+
+// weight of a sample taken with density pdf_a when the same direction could also
+// have been taken with density pdf_b (power heuristic with beta = 2)
+inline double power_heuristic(double pdf_a, double pdf_b)
+{
+  auto a2 = pdf_a * pdf_a;
+  auto b2 = pdf_b * pdf_b;
+  return a2 / (a2 + b2);
+}
+
+/*
+ *  The ray_color function is the heart of the ray tracer.
+ *  It takes a ray as input and returns a color.
+ *  The ray_color function is called recursively to generate reflections and refractions.
+ *  The ray_color function is also called for each pixel in the image to generate the final image.
+ *  Lights are only found when a scattered ray happens to hit them (pure path sampling).
+ */
+color ray_color(const ray& r, const hittable& world, int depth)
+{
+  hit_record rec;
+
+  if (depth <= 0)
+    return color(0, 0, 0);  // if we've exceeded the ray bounce limit, no more light is gathered
+
+  if (world.hit(r, 0.001, infinity, rec))
+  {
+    // we compute the normal vector at the point of intersection
+    // the normal vector is a unit vector that points outward from the surface
+    // the normal vector is computed by subtracting the center of the sphere (0,0,-1)from the point of intersection
+    // r.at(t)
+    // in diffuse shading, we compute the color of the point of intersection by adding a random vector to the normal
+    // vector
+    ray scattered;
+    color attenuation;
+    color emitted = rec.mat_ptr->emitted(r, rec);
+    // we return a color that comes from the direction of the random vector
+    if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
+      return emitted + attenuation * ray_color(scattered, world, depth - 1);
+    return emitted;
+  }
+  return sky_color(r);
+}
+
+/*
+ *  ray_color with next-event estimation.
+ *  At every diffuse hit a direction towards one of the lights is sampled and tested with a shadow ray,
+ *  besides the scattered ray. Both samples can reach the same light, so they are combined with
+ *  multiple importance sampling: scatter_pdf is the density with which the previous bounce picked r
+ *  (0 for camera rays and specular bounces, which the light sampling cannot produce).
+ */
+color ray_color(const ray& r, const hittable& world, const light_list& lights, int depth, double scatter_pdf = 0)
+{
+  hit_record rec;
+
+  if (depth <= 0)
+    return color(0, 0, 0);
+
+  if (!world.hit(r, 0.001, infinity, rec))
+    return sky_color(r);
+
+  color result = rec.mat_ptr->emitted(r, rec);
+  if (scatter_pdf > 0 && rec.mat_ptr->is_emissive())
+    result = power_heuristic(scatter_pdf, lights.pdf_value(r.origin(), r.direction())) * result;
+
+  ray scattered;
+  color attenuation;
+  if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
+    return result;
+
+  // light sampling, skipped for the materials whose scattering_pdf is always 0 (the sample would get no weight)
+  bool has_pdf = rec.mat_ptr->has_scattering_pdf();
+  if (has_pdf && !lights.empty())
+  {
+    ray to_light(rec.p, lights.random(rec.p));
+    auto bsdf_pdf = rec.mat_ptr->scattering_pdf(r, rec, to_light);
+    auto light_pdf = lights.pdf_value(rec.p, to_light.direction());
+    hit_record light_rec;
+    if (bsdf_pdf > 0 && light_pdf > 0 && lights.hit(to_light, 0.001, infinity, light_rec) &&
+        !world.occluded(to_light, 0.001, light_rec.t - 0.001))
+    {
+      // the material reflects attenuation * scattering_pdf of the incoming light
+      auto weight = power_heuristic(light_pdf, bsdf_pdf) * bsdf_pdf / light_pdf;
+      result += weight * attenuation * light_rec.mat_ptr->emitted(to_light, light_rec);
+    }
+  }
+
+  // material sampling
+  auto pdf = has_pdf ? rec.mat_ptr->scattering_pdf(r, rec, scattered) : 0;
+  return result + attenuation * ray_color(scattered, world, lights, depth - 1, pdf);
+}
+
+#endif /* INCLUDE_INTEGRATOR_HPP_ */
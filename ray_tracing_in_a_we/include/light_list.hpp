@@ -0,0 +1,98 @@
+#ifndef INCLUDE_LIGHT_LIST_HPP_
+#define INCLUDE_LIGHT_LIST_HPP_
+
+#include "hittable.hpp"
+#include "sphere.hpp"
+
+#include <vector>
+
+// light_list collects the emissive spheres of a scene (it does not own them).
+// It is used by the integrator to pick a point on a light and to find the density
+// with which a direction would have been picked.
+class light_list : public hittable
+{
+public:
+  light_list()
+  {
+  }
+
+  void clear()
+  {
+    objects.clear();
+  }
+  void add(const sphere* light)
+  {
+    objects.push_back(light);
+  }
+
+  bool empty() const
+  {
+    return objects.empty();
+  }
+  std::size_t size() const
+  {
+    return objects.size();
+  }
+
+  virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+  virtual bool bounding_box(aabb& output_box) const override;
+
+  // density of the directions returned by random(o): every light is picked with the same probability
+  double pdf_value(const point3& o, const vec3& v) const;
+  // random direction from o towards one of the lights
+  vec3 random(const point3& o) const;
+
+public:
+  std::vector<const sphere*> objects;
+};
+
+bool light_list::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
+{
+  hit_record temp_rec;
+  bool hit_anything = false;
+  auto closest_so_far = t_max;
+
+  for (const auto& light : objects)
+  {
+    if (light->sphere::hit(r, t_min, closest_so_far, temp_rec))
+    {
+      hit_anything = true;
+      closest_so_far = temp_rec.t;
+      rec = temp_rec;
+    }
+  }
+  return hit_anything;
+}
+
+bool light_list::bounding_box(aabb& output_box) const
+{
+  output_box = aabb();
+  aabb temp_box;
+  for (const auto& light : objects)
+  {
+    light->sphere::bounding_box(temp_box);
+    output_box.extend(temp_box);
+  }
+  return !objects.empty();
+}
+
+double light_list::pdf_value(const point3& o, const vec3& v) const
+{
+  if (objects.empty())
+    return 0;
+
+  auto sum = 0.0;
+  for (const auto& light : objects)
+    sum += light->pdf_value(o, v);
+  return sum / objects.size();
+}
+
+vec3 light_list::random(const point3& o) const
+{
+  auto i = static_cast<std::size_t>(random_double() * objects.size());
+  if (i >= objects.size())
+    i = objects.size() - 1;
+  return objects[i]->random(o);
+}
+
+#endif /* INCLUDE_LIGHT_LIST_HPP_ */
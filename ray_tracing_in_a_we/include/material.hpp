@@ -1,20 +1,70 @@
 #ifndef INCLUDE_MATERIAL_HPP_
 #define INCLUDE_MATERIAL_HPP_
 
+#include "hittable.hpp"
 #include "rtweekend.hpp"
+#include "texture.hpp"
 
-struct hit_record;
+// the concrete type of a material, used by the specialized render kernels to call it without virtual dispatch
+enum class material_kind : unsigned
+{
+  lambertian,
+  metal,
+  dielectric,
+  diffuse_light,
+  other
+};
+
+constexpr unsigned material_bit(material_kind k)
+{
+  return 1u << static_cast<unsigned>(k);
+}
 
 class material
 {
 public:
+  material(material_kind k = material_kind::other) : kind(k)
+  {
+  }
+
   virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
+
+  // the light emitted by the material at the point of intersection
+  virtual color emitted(const ray& r_in, const hit_record& rec) const
+  {
+    return color(0, 0, 0);
+  }
+
+  // the solid angle density with which scatter() picks the direction of the scattered ray.
+  // Materials that scatter in a single direction (or whose density is unknown) return 0:
+  // they are never sampled towards a light and they are not weighted by MIS.
+  virtual double scattering_pdf(const ray& r_in, const hit_record& rec, const ray& scattered) const
+  {
+    return 0;
+  }
+
+  // whether scattering_pdf can be positive: the integrator samples the lights only from these materials
+  virtual bool has_scattering_pdf() const
+  {
+    return false;
+  }
+
+  virtual bool is_emissive() const
+  {
+    return false;
+  }
+
+  const material_kind kind;
 };
 
 class lambertian : public material
 {
 public:
-  lambertian(const color& a) : albedo(a)
+  lambertian(const color& a) : material(material_kind::lambertian), albedo(a), albedo_texture(nullptr)
+  {
+  }
+  // the texture is not owned, it must outlive the material (see scene_arena)
+  lambertian(const texture* t) : material(material_kind::lambertian), albedo(1, 1, 1), albedo_texture(t)
   {
   }
 
@@ -29,18 +79,41 @@ public:
     // catch degenerate scatter direction
     if (scatter_direction.near_zero())
       scatter_direction = rec.normal;
-    scattered = ray(rec.p, scatter_direction);
-    attenuation = albedo;
+    scattered = ray(rec.p, scatter_direction, scattered_spread);
+    attenuation = albedo_texture ? albedo_texture->value(rec.u, rec.v, rec.p, rec.footprint) : albedo;
+    return true;
+  }
+
+  // rec.normal + random_unit_vector() is distributed as cos(theta) / pi
+  virtual double scattering_pdf(const ray& r_in, const hit_record& rec, const ray& scattered) const override
+  {
+    auto cosine = dot(rec.normal, unit_vector(scattered.direction()));
+    return cosine < 0 ? 0 : cosine / pi;
+  }
+
+  virtual bool has_scattering_pdf() const override
+  {
     return true;
   }
 
   color albedo;
+  const texture* albedo_texture;
+
+  // a diffuse bounce spreads the light over the hemisphere: the scattered rays are given a wide cone,
+  // so that the textures they hit are read from the coarse MIP levels
+  static constexpr double scattered_spread = 0.5;
 };
 
 class metal : public material
 {
 public:
-  metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1)
+  metal(const color& a, double f)
+      : material(material_kind::metal), albedo(a), albedo_texture(nullptr), fuzz(f < 1 ? f : 1)
+  {
+  }
+  // the texture is not owned, it must outlive the material (see scene_arena)
+  metal(const texture* t, double f)
+      : material(material_kind::metal), albedo(1, 1, 1), albedo_texture(t), fuzz(f < 1 ? f : 1)
   {
   }
 
@@ -52,19 +125,21 @@ public:
   {
     vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
     // fuzzy reflection
-    scattered = ray(rec.p, reflected + fuzz * random_in_unit_sphere());
-    attenuation = albedo;
+    // a fuzzy reflection widens the cone of the ray
+    scattered = ray(rec.p, reflected + fuzz * random_in_unit_sphere(), r_in.spread + fuzz);
+    attenuation = albedo_texture ? albedo_texture->value(rec.u, rec.v, rec.p, rec.footprint) : albedo;
     return (dot(scattered.direction(), rec.normal) > 0);
   }
 
   color albedo;
+  const texture* albedo_texture;
   double fuzz;
 };
 
 class dielectric : public material
 {
 public:
-  dielectric(double index_of_refraction) : ir(index_of_refraction)
+  dielectric(double index_of_refraction) : material(material_kind::dielectric), ir(index_of_refraction)
   {
   }
   virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override
@@ -85,7 +160,7 @@ public:
     {
       direction = refract(unit_direction, rec.normal, refraction_ratio);
     }
-    scattered = ray(rec.p, direction);
+    scattered = ray(rec.p, direction, r_in.spread);
     return true;
   }
 
@@ -102,4 +177,31 @@ public:
   double ir;  // Index of Refraction
 };
 
+class diffuse_light : public material
+{
+public:
+  diffuse_light(const color& c) : material(material_kind::diffuse_light), emit(c)
+  {
+  }
+
+  // a light source absorbs every ray that hits it
+  virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override
+  {
+    return false;
+  }
+
+  // the light is emitted only on the outer side of the surface
+  virtual color emitted(const ray& r_in, const hit_record& rec) const override
+  {
+    return rec.front_face ? emit : color(0, 0, 0);
+  }
+
+  virtual bool is_emissive() const override
+  {
+    return true;
+  }
+
+  color emit;
+};
+
 #endif /* INCLUDE_MATERIAL_HPP_ */
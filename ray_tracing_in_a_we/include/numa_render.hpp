@@ -0,0 +1,284 @@
+#ifndef INCLUDE_NUMA_RENDER_HPP_
+#define INCLUDE_NUMA_RENDER_HPP_
+
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "numa_topology.hpp"
+#include "render_kernel.hpp"
+#include "scene_arena.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *  NUMA-aware parallel rendering.
+ *  One worker thread runs on every usable CPU and is pinned to it. The tiles of the image are split
+ *  among the nodes in proportion to their CPUs, so that a tile is rendered, and its memory first
+ *  touched, by a thread of the node it was assigned to; a node that runs out of tiles takes the
+ *  remaining ones of the other nodes. Optionally every node traces its own replica of the scene.
+ */
+
+struct numa_options
+{
+  bool pin_threads = true;
+  bool replicate_scene = true;
+  int tile_size = 32;
+};
+
+struct numa_node_report
+{
+  int node;
+  int threads;
+  int tiles;
+  double samples_per_second;
+  // single thread time / time in the parallel render, of the calibration tiles rendered by the node
+  double efficiency;
+};
+
+struct numa_report
+{
+  // time of the parallel render, and of the single thread calibration that precedes it
+  double seconds;
+  double calibration_seconds;
+  double serial_samples_per_second;
+  std::vector<numa_node_report> nodes;
+};
+
+// framebuffer made of separately allocated tiles, each one allocated by the thread that renders it
+class tiled_framebuffer
+{
+public:
+  tiled_framebuffer(int width, int height, int tile_size)
+      : width(width)
+      , height(height)
+      , tile_size(tile_size)
+      , tiles_x((width + tile_size - 1) / tile_size)
+      , tiles_y((height + tile_size - 1) / tile_size)
+      , tiles(tiles_x * tiles_y)
+  {
+  }
+
+  int count() const
+  {
+    return tiles_x * tiles_y;
+  }
+
+  // the pixels [x0, x1) x [y0, y1) of a tile, y grows downwards
+  void bounds(int tile, int& x0, int& y0, int& x1, int& y1) const
+  {
+    x0 = (tile % tiles_x) * tile_size;
+    y0 = (tile / tiles_x) * tile_size;
+    x1 = std::min(x0 + tile_size, width);
+    y1 = std::min(y0 + tile_size, height);
+  }
+
+  // allocates and zeroes the pixels of a tile on the calling thread
+  color* allocate(int tile)
+  {
+    tiles[tile].reset(new color[tile_size * tile_size]);
+    return tiles[tile].get();
+  }
+
+  // the sum of the samples of the pixel (x, y), y grows downwards
+  color pixel(int x, int y) const
+  {
+    int tile = (y / tile_size) * tiles_x + x / tile_size;
+    return tiles[tile][(y % tile_size) * tile_size + x % tile_size];
+  }
+
+public:
+  const int width;
+  const int height;
+  const int tile_size;
+
+private:
+  int tiles_x;
+  int tiles_y;
+  std::vector<std::unique_ptr<color[]>> tiles;
+};
+
+// renders a tile of the framebuffer into memory allocated by the calling thread, returns the number of samples
+double render_framebuffer_tile(const scene_arena& world, const camera& cam, const render_config& config,
+                               tiled_framebuffer& framebuffer, int tile)
+{
+  int x0, y0, x1, y1;
+  framebuffer.bounds(tile, x0, y0, x1, y1);
+  color* pixels = framebuffer.allocate(tile);
+  scanline_kernel kernel = select_kernel(world, cam, config);
+  for (int y = y0; y < y1; ++y)
+    kernel(world, cam, config, config.height - 1 - y, x0, x1, pixels + (y - y0) * framebuffer.tile_size);
+  return double(x1 - x0) * (y1 - y0) * config.samples_per_pixel;
+}
+
+numa_report render_numa(const scene_arena& world, const camera& cam, const render_config& config,
+                        const numa_options& options, tiled_framebuffer& framebuffer)
+{
+  using numa_clock = std::chrono::steady_clock;
+  auto nodes = discover_numa_topology();
+  const int n_nodes = static_cast<int>(nodes.size());
+  const int n_tiles = framebuffer.count();
+
+  // the replicas are built by a thread of their node, so that their memory is local to it
+  std::vector<std::unique_ptr<scene_arena>> replicas(n_nodes);
+  if (options.replicate_scene && n_nodes > 1)
+  {
+    std::vector<std::thread> builders;
+    for (int n = 0; n < n_nodes; n++)
+      builders.emplace_back([&, n] {
+        if (options.pin_threads)
+          pin_current_thread(nodes[n].cpus);
+        replicas[n].reset(new scene_arena);
+        world.copy_to(*replicas[n]);
+      });
+    for (auto& builder : builders)
+      builder.join();
+  }
+  auto scene_of = [&](int n) -> const scene_arena& { return replicas[n] ? *replicas[n] : world; };
+
+  numa_report report;
+
+  // the efficiency compares the time of the same tiles rendered alone and in the parallel render.
+  // A few tiles, spread over the image, are first rendered into a scratch framebuffer on one pinned
+  // thread, with at most calibration_spp samples per pixel: their time is scaled to the samples of the
+  // render, so that the calibration costs about as much as a few tiles whatever the image and the spp.
+  const int calibration_tiles = 8;
+  const int calibration_spp = 16;
+  const int calibration_runs = 3;
+  render_config calibration_config = config;
+  calibration_config.samples_per_pixel = std::min(config.samples_per_pixel, calibration_spp);
+  const double spp_scale = double(config.samples_per_pixel) / calibration_config.samples_per_pixel;
+  std::vector<char> is_calibration_tile(n_tiles, 0);
+  for (int k = 0; k < calibration_tiles; k++)
+    is_calibration_tile[static_cast<long long>(2 * k + 1) * n_tiles / (2 * calibration_tiles)] = 1;
+  std::vector<double> serial_seconds(n_tiles, 0);
+
+  auto calibration_start = numa_clock::now();
+  std::thread calibration([&] {
+    if (options.pin_threads)
+      pin_current_thread(std::vector<int>(1, nodes[0].cpus[0]));
+    tiled_framebuffer scratch(framebuffer.width, framebuffer.height, framebuffer.tile_size);
+    double samples = 0, seconds = 0;
+    // the first tile is rendered once untimed, so that the caches are as warm as for the workers
+    bool warm = false;
+    for (int tile = 0; tile < n_tiles; tile++)
+    {
+      if (!is_calibration_tile[tile])
+        continue;
+      if (!warm)
+      {
+        render_framebuffer_tile(scene_of(0), cam, calibration_config, scratch, tile);
+        warm = true;
+      }
+      // the fastest of a few runs, short runs are easily disturbed
+      double fastest = infinity, tile_samples = 0;
+      for (int run = 0; run < calibration_runs; run++)
+      {
+        auto start = numa_clock::now();
+        tile_samples = render_framebuffer_tile(scene_of(0), cam, calibration_config, scratch, tile);
+        fastest = std::min(fastest, std::chrono::duration<double>(numa_clock::now() - start).count());
+      }
+      samples += tile_samples;
+      seconds += fastest;
+      serial_seconds[tile] = fastest * spp_scale;
+    }
+    report.serial_samples_per_second = seconds > 0 ? samples / seconds : 0;
+  });
+  calibration.join();
+  report.calibration_seconds = std::chrono::duration<double>(numa_clock::now() - calibration_start).count();
+
+  // the tiles are split in contiguous ranges, one per node, in proportion to its CPUs
+  int n_cpus = 0;
+  for (const auto& node : nodes)
+    n_cpus += static_cast<int>(node.cpus.size());
+  std::vector<int> range_end(n_nodes);
+  std::unique_ptr<std::atomic<int>[]> next_tile(new std::atomic<int>[n_nodes]);
+  int first = 0, cpus_so_far = 0;
+  for (int n = 0; n < n_nodes; n++)
+  {
+    cpus_so_far += static_cast<int>(nodes[n].cpus.size());
+    next_tile[n] = first;
+    range_end[n] = static_cast<int>(static_cast<long long>(n_tiles) * cpus_so_far / n_cpus);
+    first = range_end[n];
+  }
+
+  // tiles and samples rendered by the threads of every node, and the single thread and parallel
+  // times of its calibration tiles
+  std::vector<int> tiles_done(n_nodes, 0);
+  std::vector<double> samples_done(n_nodes, 0);
+  std::vector<double> calibration_serial(n_nodes, 0), calibration_parallel(n_nodes, 0);
+  std::mutex done_mutex;
+
+  auto start = numa_clock::now();
+  std::vector<std::thread> workers;
+  for (int n = 0; n < n_nodes; n++)
+  {
+    for (int cpu : nodes[n].cpus)
+    {
+      workers.emplace_back([&, n, cpu] {
+        if (options.pin_threads)
+          pin_current_thread(std::vector<int>(1, cpu));
+        int tiles = 0;
+        double samples = 0, serial = 0, parallel = 0;
+        // own node first, then help the others
+        for (int k = 0; k < n_nodes; k++)
+        {
+          int owner = (n + k) % n_nodes;
+          int tile;
+          while ((tile = next_tile[owner]++) < range_end[owner])
+          {
+            auto tile_start = numa_clock::now();
+            samples += render_framebuffer_tile(scene_of(n), cam, config, framebuffer, tile);
+            if (is_calibration_tile[tile])
+            {
+              serial += serial_seconds[tile];
+              parallel += std::chrono::duration<double>(numa_clock::now() - tile_start).count();
+            }
+            tiles++;
+          }
+        }
+        std::lock_guard<std::mutex> lock(done_mutex);
+        tiles_done[n] += tiles;
+        samples_done[n] += samples;
+        calibration_serial[n] += serial;
+        calibration_parallel[n] += parallel;
+      });
+    }
+  }
+  for (auto& worker : workers)
+    worker.join();
+  report.seconds = std::chrono::duration<double>(numa_clock::now() - start).count();
+
+  for (int n = 0; n < n_nodes; n++)
+  {
+    numa_node_report node;
+    node.node = nodes[n].id;
+    node.threads = static_cast<int>(nodes[n].cpus.size());
+    node.tiles = tiles_done[n];
+    node.samples_per_second = samples_done[n] / report.seconds;
+    // a node that rendered no calibration tile is compared with the single thread throughput
+    if (calibration_parallel[n] > 0)
+      node.efficiency = calibration_serial[n] / calibration_parallel[n];
+    else
+      node.efficiency = node.samples_per_second / (node.threads * report.serial_samples_per_second);
+    report.nodes.push_back(node);
+  }
+  return report;
+}
+
+void print_numa_report(std::ostream& out, const numa_report& report)
+{
+  out << "NUMA render: " << report.seconds << " s (calibration " << report.calibration_seconds
+      << " s), single thread " << report.serial_samples_per_second << " samples/s\n";
+  for (const auto& node : report.nodes)
+    out << "  node " << node.node << ": " << node.threads << " threads, " << node.tiles << " tiles, "
+        << node.samples_per_second << " samples/s, efficiency " << 100 * node.efficiency << "%\n";
+}
+
+#endif /* INCLUDE_NUMA_RENDER_HPP_ */
@@ -0,0 +1,95 @@
+#ifndef INCLUDE_NUMA_TOPOLOGY_HPP_
+#define INCLUDE_NUMA_TOPOLOGY_HPP_
+
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// a NUMA node (usually a socket) and the CPUs attached to it
+struct numa_node
+{
+  int id;
+  std::vector<int> cpus;
+};
+
+// parses a sysfs CPU list such as "0-3,8-11"
+std::vector<int> parse_cpu_list(const std::string& list)
+{
+  std::vector<int> cpus;
+  std::istringstream in(list);
+  std::string range;
+  while (std::getline(in, range, ','))
+  {
+    if (range.empty() || range == "\n")
+      continue;
+    auto dash = range.find('-');
+    int first = std::stoi(range.substr(0, dash));
+    int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+/*
+ *  Reads the NUMA nodes from /sys/devices/system/node, keeping only the CPUs the process may run on.
+ *  Nodes without usable CPUs (memory-only nodes) are skipped. Without NUMA information the whole
+ *  machine is reported as a single node.
+ */
+std::vector<numa_node> discover_numa_topology()
+{
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+  std::vector<numa_node> nodes;
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string online_list;
+  if (online && std::getline(online, online_list))
+  {
+    for (int id : parse_cpu_list(online_list))
+    {
+      std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+      std::string list;
+      if (!cpulist || !std::getline(cpulist, list))
+        continue;
+
+      numa_node node;
+      node.id = id;
+      for (int cpu : parse_cpu_list(list))
+        if (!have_mask || CPU_ISSET(cpu, &allowed))
+          node.cpus.push_back(cpu);
+      if (!node.cpus.empty())
+        nodes.push_back(node);
+    }
+  }
+
+  if (nodes.empty())
+  {
+    numa_node node;
+    node.id = 0;
+    unsigned n = std::thread::hardware_concurrency();
+    for (unsigned cpu = 0; cpu < (n ? n : 1); cpu++)
+      if (!have_mask || CPU_ISSET(cpu, &allowed))
+        node.cpus.push_back(static_cast<int>(cpu));
+    if (node.cpus.empty())
+      node.cpus.push_back(0);
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+// restricts the calling thread to the given CPUs, returns false if the kernel refuses
+bool pin_current_thread(const std::vector<int>& cpus)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+    CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#endif /* INCLUDE_NUMA_TOPOLOGY_HPP_ */
@@ -6,10 +6,10 @@
 class ray
 {
 public:
-  ray()
+  ray() : spread(0)
   {
   }
-  ray(const point3& origin, const vec3& direction) : orig(origin), dir(direction)
+  ray(const point3& origin, const vec3& direction, double spread = 0) : orig(origin), dir(direction), spread(spread)
   {
   }
 
@@ -30,6 +30,8 @@ public:
 public:
   point3 orig;
   vec3 dir;
+  // growth of the width of the ray footprint per unit of length along the ray (a cone), 0 for a thin ray
+  double spread;
 };
 
 #endif /* INCLUDE_RAY_HPP_ */
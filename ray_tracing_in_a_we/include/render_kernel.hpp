@@ -0,0 +1,214 @@
+#ifndef INCLUDE_RENDER_KERNEL_HPP_
+#define INCLUDE_RENDER_KERNEL_HPP_
+
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "integrator.hpp"
+#include "material.hpp"
+#include "scene_arena.hpp"
+
+/*
+ *  Render kernels compute the pixels of a scanline.
+ *  The generic kernel goes through the virtual material interface and the runtime camera and depth.
+ *  The specialized kernels are instantiated for a known set of materials, a pinhole or thin-lens camera
+ *  and a fixed depth limit: materials are called through their concrete type, the camera branch and the
+ *  bounce loop bound are resolved at compile time.
+ *  select_kernel picks the instantiation that matches a scene and a configuration.
+ */
+
+struct render_config
+{
+  int width;
+  int height;
+  int samples_per_pixel;
+  int max_depth;
+};
+
+// computes the sum of the samples of the pixels [i0, i1) of the row j (j = 0 is the bottom row)
+using scanline_kernel = void (*)(const scene_arena& world, const camera& cam, const render_config& config, int j,
+                                 int i0, int i1, color* out);
+
+void generic_scanline(const scene_arena& world, const camera& cam, const render_config& config, int j, int i0, int i1,
+                      color* out)
+{
+  const double spread = cam.pixel_spread(config.height);
+  for (int i = i0; i < i1; ++i)
+  {
+    color pixel_color(0, 0, 0);
+    for (int s = 0; s < config.samples_per_pixel; ++s)
+    {
+      auto u = (i + random_double()) / (config.width - 1);
+      auto v = (j + random_double()) / (config.height - 1);
+      ray r = cam.get_ray(u, v);
+      r.spread = spread;
+      pixel_color += ray_color(r, world, world.lights(), config.max_depth);
+    }
+    *out++ = pixel_color;
+  }
+}
+
+// Material calls resolved at compile time.
+// The kind of m must be one of Kinds; the virtual call is only a fallback for other kinds.
+
+template <unsigned Kinds>
+inline bool static_scatter(const material* m, const ray& r_in, const hit_record& rec, color& attenuation,
+                           ray& scattered)
+{
+  if constexpr ((Kinds & material_bit(material_kind::lambertian)) != 0)
+    if (m->kind == material_kind::lambertian)
+      return static_cast<const lambertian*>(m)->lambertian::scatter(r_in, rec, attenuation, scattered);
+  if constexpr ((Kinds & material_bit(material_kind::metal)) != 0)
+    if (m->kind == material_kind::metal)
+      return static_cast<const metal*>(m)->metal::scatter(r_in, rec, attenuation, scattered);
+  if constexpr ((Kinds & material_bit(material_kind::dielectric)) != 0)
+    if (m->kind == material_kind::dielectric)
+      return static_cast<const dielectric*>(m)->dielectric::scatter(r_in, rec, attenuation, scattered);
+  if constexpr ((Kinds & material_bit(material_kind::diffuse_light)) != 0)
+    if (m->kind == material_kind::diffuse_light)
+      return false;
+  return m->scatter(r_in, rec, attenuation, scattered);
+}
+
+/*
+ *  Iterative version of ray_color with next-event estimation for a fixed set of materials.
+ *  It consumes the random numbers in the same order as ray_color, and it does the same
+ *  work: only lambertian surfaces (the only materials with a scattering density) sample
+ *  the lights and only diffuse lights emit.
+ *  The scene and the lights are traced through their concrete types, without virtual calls.
+ */
+template <unsigned Kinds, int MaxDepth>
+color static_ray_color(ray r, const scene_arena& world)
+{
+  constexpr bool has_lambertian = (Kinds & material_bit(material_kind::lambertian)) != 0;
+  constexpr bool has_lights = (Kinds & material_bit(material_kind::diffuse_light)) != 0;
+
+  const light_list& lights = world.lights();
+  color result(0, 0, 0);
+  color throughput(1, 1, 1);
+  double scatter_pdf = 0;
+
+  for (int depth = 0; depth < MaxDepth; ++depth)
+  {
+    hit_record rec;
+    if (!world.scene_arena::hit(r, 0.001, infinity, rec))
+      return result + throughput * sky_color(r);
+
+    const material* m = rec.mat_ptr;
+    if constexpr (has_lights)
+    {
+      if (m->kind == material_kind::diffuse_light)
+      {
+        color emitted = static_cast<const diffuse_light*>(m)->diffuse_light::emitted(r, rec);
+        if (scatter_pdf > 0)
+          emitted = power_heuristic(scatter_pdf, lights.pdf_value(r.origin(), r.direction())) * emitted;
+        return result + throughput * emitted;
+      }
+    }
+
+    ray scattered;
+    color attenuation;
+    if (!static_scatter<Kinds>(m, r, rec, attenuation, scattered))
+      return result;
+
+    scatter_pdf = 0;
+    if constexpr (has_lambertian)
+    {
+      if (m->kind == material_kind::lambertian)
+      {
+        auto l = static_cast<const lambertian*>(m);
+        if constexpr (has_lights)
+        {
+          if (!lights.empty())
+          {
+            ray to_light(rec.p, lights.random(rec.p));
+            auto bsdf_pdf = l->lambertian::scattering_pdf(r, rec, to_light);
+            auto light_pdf = lights.pdf_value(rec.p, to_light.direction());
+            hit_record light_rec;
+            if (bsdf_pdf > 0 && light_pdf > 0 && lights.light_list::hit(to_light, 0.001, infinity, light_rec) &&
+                !world.scene_arena::occluded(to_light, 0.001, light_rec.t - 0.001))
+            {
+              auto weight = power_heuristic(light_pdf, bsdf_pdf) * bsdf_pdf / light_pdf;
+              result += weight * throughput * attenuation * light_rec.mat_ptr->emitted(to_light, light_rec);
+            }
+          }
+        }
+        scatter_pdf = l->lambertian::scattering_pdf(r, rec, scattered);
+      }
+    }
+
+    throughput = throughput * attenuation;
+    r = scattered;
+  }
+  return result;
+}
+
+template <unsigned Kinds, bool ThinLens, int MaxDepth>
+void static_scanline(const scene_arena& world, const camera& cam, const render_config& config, int j, int i0, int i1,
+                     color* out)
+{
+  const double spread = cam.pixel_spread(config.height);
+  for (int i = i0; i < i1; ++i)
+  {
+    color pixel_color(0, 0, 0);
+    for (int s = 0; s < config.samples_per_pixel; ++s)
+    {
+      auto u = (i + random_double()) / (config.width - 1);
+      auto v = (j + random_double()) / (config.height - 1);
+      ray r = cam.sample_ray<ThinLens>(u, v);
+      r.spread = spread;
+      pixel_color += static_ray_color<Kinds, MaxDepth>(r, world);
+    }
+    *out++ = pixel_color;
+  }
+}
+
+// Instantiation selection
+
+// the material sets with a specialized kernel, from the smallest to the largest
+const unsigned diffuse_materials = material_bit(material_kind::lambertian);
+const unsigned lit_diffuse_materials = diffuse_materials | material_bit(material_kind::diffuse_light);
+const unsigned surface_materials =
+    diffuse_materials | material_bit(material_kind::metal) | material_bit(material_kind::dielectric);
+const unsigned all_materials = surface_materials | material_bit(material_kind::diffuse_light);
+
+template <unsigned Kinds, bool ThinLens>
+scanline_kernel select_depth(int max_depth)
+{
+  switch (max_depth)
+  {
+    case 10:
+      return &static_scanline<Kinds, ThinLens, 10>;
+    case 50:
+      return &static_scanline<Kinds, ThinLens, 50>;
+    default:
+      return nullptr;
+  }
+}
+
+template <unsigned Kinds>
+scanline_kernel select_camera(const camera& cam, int max_depth)
+{
+  return cam.is_pinhole() ? select_depth<Kinds, false>(max_depth) : select_depth<Kinds, true>(max_depth);
+}
+
+// the specialized kernel for the smallest material set that contains the scene materials,
+// or the generic kernel if the depth limit has no instantiation
+scanline_kernel select_kernel(const scene_arena& world, const camera& cam, const render_config& config)
+{
+  unsigned kinds = world.material_kinds();
+  scanline_kernel kernel;
+  if ((kinds & ~diffuse_materials) == 0)
+    kernel = select_camera<diffuse_materials>(cam, config.max_depth);
+  else if ((kinds & ~lit_diffuse_materials) == 0)
+    kernel = select_camera<lit_diffuse_materials>(cam, config.max_depth);
+  else if ((kinds & ~surface_materials) == 0)
+    kernel = select_camera<surface_materials>(cam, config.max_depth);
+  else if ((kinds & ~all_materials) == 0)
+    kernel = select_camera<all_materials>(cam, config.max_depth);
+  else
+    kernel = nullptr;
+  return kernel ? kernel : &generic_scanline;
+}
+
+#endif /* INCLUDE_RENDER_KERNEL_HPP_ */
@@ -0,0 +1,185 @@
+#ifndef INCLUDE_RENDER_PROTOCOL_HPP_
+#define INCLUDE_RENDER_PROTOCOL_HPP_
+
+#include "rtweekend.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ *  Protocol of the render server, over a Unix stream socket.
+ *  Commands and replies are text lines; scene descriptions and tile pixels follow
+ *  their line as a block of raw bytes.
+ *
+ *    SCENE <n>\n<n bytes of scene description>   ->  OK <scene key> | ERROR <message>
+ *    RENDER <render_job fields>                   ->  TILE <x> <y> <w> <h>\n<w * h * 3 bytes> ... DONE
+ *                                                     | ERROR <message>
+ *    QUIT                                         ->  the server closes the connection
+ *
+ *  The server evicts the least recently used scenes past its memory budget: RENDER then replies
+ *  ERROR unknown scene, and the client sends the scene again.
+ *  Tiles are streamed as soon as they are rendered, in no particular order.
+ *  Pixels are 8 bit RGB, row by row from the top of the tile.
+ */
+
+// a render request for a region of an image
+struct render_job
+{
+  std::string scene;  // key returned by SCENE
+  int width = 1200;
+  int height = 800;
+  int samples_per_pixel = 100;
+  int max_depth = 50;
+  // region [x0, x1) x [y0, y1) of the image, y grows downwards; x1 = y1 = 0 means the whole image
+  int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+  point3 lookfrom = point3(13, 2, 3);
+  point3 lookat = point3(0, 0, 0);
+  vec3 vup = vec3(0, 1, 0);
+  double vfov = 20;
+  double aperture = 0.1;
+  double focus_dist = 10;
+};
+
+// the RENDER command line for a job
+std::string format_render_job(const render_job& job)
+{
+  std::ostringstream out;
+  out.precision(17);
+  out << "RENDER " << job.scene << ' ' << job.width << ' ' << job.height << ' ' << job.samples_per_pixel << ' '
+      << job.max_depth << ' ' << job.x0 << ' ' << job.y0 << ' ' << job.x1 << ' ' << job.y1 << ' ' << job.lookfrom << ' '
+      << job.lookat << ' ' << job.vup << ' ' << job.vfov << ' ' << job.aperture << ' ' << job.focus_dist;
+  return out.str();
+}
+
+// the largest jobs accepted by the server: the tile list and the pixels of an image stay small,
+// and the recursion of the generic kernel (used for the depths without a specialized kernel)
+// stays well within the stack of a pool thread
+const int max_image_size = 16384;
+const int max_samples_per_pixel = 1 << 16;
+const int max_render_depth = 1000;
+
+// parses a RENDER command line. Returns false and sets error if it is malformed, a field is out
+// of its limits or the region is not inside the image.
+bool parse_render_job(const std::string& line, render_job& job, std::string& error)
+{
+  std::istringstream in(line);
+  std::string command;
+  in >> command >> job.scene >> job.width >> job.height >> job.samples_per_pixel >> job.max_depth >> job.x0 >> job.y0 >>
+      job.x1 >> job.y1;
+  for (int i = 0; i < 3; i++)
+    in >> job.lookfrom[i];
+  for (int i = 0; i < 3; i++)
+    in >> job.lookat[i];
+  for (int i = 0; i < 3; i++)
+    in >> job.vup[i];
+  in >> job.vfov >> job.aperture >> job.focus_dist;
+  if (!in || command != "RENDER")
+  {
+    error = "malformed render job";
+    return false;
+  }
+
+  if (job.width <= 0 || job.width > max_image_size || job.height <= 0 || job.height > max_image_size)
+  {
+    error = "the image size must be between 1 and " + std::to_string(max_image_size);
+    return false;
+  }
+  if (job.samples_per_pixel <= 0 || job.samples_per_pixel > max_samples_per_pixel)
+  {
+    error = "the samples per pixel must be between 1 and " + std::to_string(max_samples_per_pixel);
+    return false;
+  }
+  if (job.max_depth <= 0 || job.max_depth > max_render_depth)
+  {
+    error = "the depth must be between 1 and " + std::to_string(max_render_depth);
+    return false;
+  }
+
+  if (job.x1 == 0 && job.y1 == 0)
+  {
+    job.x1 = job.width;
+    job.y1 = job.height;
+  }
+  if (!(0 <= job.x0 && job.x0 < job.x1 && job.x1 <= job.width && 0 <= job.y0 && job.y0 < job.y1 &&
+        job.y1 <= job.height))
+  {
+    error = "the region is not inside the image";
+    return false;
+  }
+  return true;
+}
+
+// Blocking socket helpers
+
+// sends n bytes, returns false if the peer went away
+inline bool write_all(int fd, const void* data, std::size_t n)
+{
+  auto bytes = static_cast<const char*>(data);
+  while (n > 0)
+  {
+    auto sent = send(fd, bytes, n, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+    bytes += sent;
+    n -= static_cast<std::size_t>(sent);
+  }
+  return true;
+}
+
+inline bool write_line(int fd, const std::string& line)
+{
+  return write_all(fd, (line + '\n').data(), line.size() + 1);
+}
+
+// receives exactly n bytes, returns false if the peer went away
+inline bool read_exact(int fd, void* data, std::size_t n)
+{
+  auto bytes = static_cast<char*>(data);
+  while (n > 0)
+  {
+    auto received = recv(fd, bytes, n, 0);
+    if (received < 0 && errno == EINTR)
+      continue;
+    if (received <= 0)
+      return false;
+    bytes += received;
+    n -= static_cast<std::size_t>(received);
+  }
+  return true;
+}
+
+// receives a line without its '\n', returns false if the peer went away or the line is longer than max_length
+inline bool read_line(int fd, std::string& line, std::size_t max_length = 4096)
+{
+  line.clear();
+  char c;
+  while (read_exact(fd, &c, 1))
+  {
+    if (c == '\n')
+      return true;
+    if (line.size() == max_length)
+      return false;
+    line += c;
+  }
+  return false;
+}
+
+// fills addr with the address of the socket at path, returns false if the path is too long
+inline bool unix_address(const std::string& path, sockaddr_un& addr)
+{
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    return false;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+#endif /* INCLUDE_RENDER_PROTOCOL_HPP_ */
@@ -0,0 +1,401 @@
+#ifndef INCLUDE_RENDER_SERVER_HPP_
+#define INCLUDE_RENDER_SERVER_HPP_
+
+#include "rtweekend.hpp"
+
+#include "camera.hpp"
+#include "color.hpp"
+#include "render_kernel.hpp"
+#include "render_protocol.hpp"
+#include "scene_arena.hpp"
+#include "scene_loader.hpp"
+#include "texture_cache.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// scene_cache keeps the loaded scenes, keyed by the hash of their description,
+// so that a scene is built only once however many jobs render it.
+// The scenes are kept under a memory budget: the least recently used ones are evicted
+// (a job still rendering an evicted scene keeps it alive until it is done).
+class scene_cache
+{
+public:
+  // the scenes (their descriptions included) are kept within scene_budget bytes,
+  // and their textures share a cache of texture_budget bytes
+  explicit scene_cache(std::size_t scene_budget = std::size_t(4) << 30, std::size_t texture_budget = 256 << 20)
+      : textures(texture_budget), budget(scene_budget)
+  {
+  }
+
+  // loads the scene described by text unless it is already cached and sets key to its key.
+  // Returns false and sets error if the description cannot be parsed, or if its key is
+  // already taken by a different description.
+  bool load(const std::string& text, std::string& key, std::string& error)
+  {
+    key = scene_hash(text);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = scenes.find(key);
+      if (it != scenes.end())
+        return same_text(it->second, text, error);
+    }
+
+    // build outside the lock, another connection may be loading a different scene
+    auto world = make_shared<scene_arena>();
+    if (!load_scene(text, *world, error, &textures))
+      return false;
+    world->build_bvh();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // another connection may have loaded it meanwhile
+    auto it = scenes.find(key);
+    if (it != scenes.end())
+      return same_text(it->second, text, error);
+    lru.push_front(key);
+    entry& e = scenes[key];
+    e.text = text;
+    e.world = world;
+    e.bytes = text.size() + world->bytes();
+    e.position = lru.begin();
+    bytes += e.bytes;
+
+    // the scene just loaded is kept even if it is larger than the budget
+    while (bytes > budget && lru.size() > 1)
+    {
+      auto evicted = scenes.find(lru.back());
+      bytes -= evicted->second.bytes;
+      scenes.erase(evicted);
+      lru.pop_back();
+    }
+    return true;
+  }
+
+  // the scene with this key, or null if it was never loaded or has been evicted
+  shared_ptr<const scene_arena> find(const std::string& key)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = scenes.find(key);
+    if (it == scenes.end())
+      return nullptr;
+    lru.splice(lru.begin(), lru, it->second.position);
+    return it->second.world;
+  }
+
+  std::size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return scenes.size();
+  }
+
+  texture_cache_stats texture_stats() const
+  {
+    return textures.stats();
+  }
+
+private:
+  struct entry
+  {
+    std::string text;
+    shared_ptr<const scene_arena> world;
+    std::size_t bytes;
+    std::list<std::string>::iterator position;
+  };
+
+  // a hash collision must not render another scene than the one sent
+  bool same_text(entry& e, const std::string& text, std::string& error)
+  {
+    if (e.text != text)
+    {
+      error = "the scene key collides with another cached scene";
+      return false;
+    }
+    lru.splice(lru.begin(), lru, e.position);
+    return true;
+  }
+
+  // declared first, the scenes reference it
+  texture_cache textures;
+  mutable std::mutex mutex;
+  std::map<std::string, entry> scenes;
+  // keys from the most to the least recently used
+  std::list<std::string> lru;
+  std::size_t bytes = 0;
+  std::size_t budget;
+};
+
+// renders the pixels [x0, x1) x [y0, y1) of the job image as 8 bit RGB, row by row from the top
+void render_tile(const scene_arena& world, const camera& cam, const render_job& job, int x0, int y0, int x1, int y1,
+                 std::vector<unsigned char>& pixels)
+{
+  render_config config{ job.width, job.height, job.samples_per_pixel, job.max_depth };
+  scanline_kernel kernel = select_kernel(world, cam, config);
+  std::vector<color> row(x1 - x0);
+
+  pixels.resize(3 * (x1 - x0) * (y1 - y0));
+  auto out = pixels.data();
+  for (int y = y0; y < y1; ++y)
+  {
+    // rows are numbered from the top, j goes from 0 at the bottom of the image
+    kernel(world, cam, config, job.height - 1 - y, x0, x1, row.data());
+    for (const auto& pixel_color : row)
+    {
+      color_to_bytes(out, pixel_color, job.samples_per_pixel);
+      out += 3;
+    }
+  }
+}
+
+/*
+ *  The render server keeps the loaded scenes in memory between jobs.
+ *  Every client connection is served by its own thread, which writes the tiles of its jobs,
+ *  while the tiles of all the jobs are rendered by a single shared thread pool.
+ */
+class render_server
+{
+public:
+  static const int tile_size = 32;
+
+  render_server(const std::string& socket_path, unsigned n_threads = std::thread::hardware_concurrency())
+      : socket_path(socket_path), pool(n_threads)
+  {
+  }
+
+  // listens on the socket and serves clients until the process is stopped.
+  // Returns a non-zero exit code if the socket cannot be opened.
+  int run();
+
+private:
+  void serve(int fd);
+  bool render(int fd, const render_job& job);
+
+  std::string socket_path;
+  scene_cache scenes;
+  thread_pool pool;
+};
+
+int render_server::run()
+{
+  sockaddr_un addr;
+  if (!unix_address(socket_path, addr))
+  {
+    std::cerr << "socket path too long: " << socket_path << std::endl;
+    return 1;
+  }
+
+  // a socket left by a previous server is replaced, any other file is kept
+  struct stat existing;
+  if (lstat(socket_path.c_str(), &existing) == 0)
+  {
+    if (!S_ISSOCK(existing.st_mode))
+    {
+      std::cerr << "cannot listen on " << socket_path << ": the file exists and is not a socket" << std::endl;
+      return 1;
+    }
+    unlink(socket_path.c_str());
+  }
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listener, 16) < 0)
+  {
+    std::cerr << "cannot listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+  std::cerr << "render server listening on " << socket_path << " with " << pool.size() << " threads" << std::endl;
+
+  while (true)
+  {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+      close(listener);
+      return 1;
+    }
+    std::thread([this, fd] {
+      serve(fd);
+      close(fd);
+    }).detach();
+  }
+}
+
+void render_server::serve(int fd)
+{
+  // the largest scene description accepted
+  const std::size_t max_scene_bytes = 256 << 20;
+  // scene descriptions are received by chunks of this size, so that the memory allocated follows
+  // the bytes actually sent and not the size announced by the client
+  const std::size_t scene_chunk_bytes = 1 << 20;
+
+  // an error while serving a client (e.g. an allocation failure) closes its connection only
+  try
+  {
+    std::string line;
+    while (read_line(fd, line))
+    {
+      std::istringstream command_line(line);
+      std::string command;
+      command_line >> command;
+
+      if (command == "SCENE")
+      {
+        std::size_t n = 0;
+        if (!(command_line >> n) || n > max_scene_bytes)
+        {
+          write_line(fd, "ERROR invalid scene size");
+          return;
+        }
+        std::string text;
+        while (text.size() < n)
+        {
+          auto received = text.size();
+          text.resize(received + std::min(scene_chunk_bytes, n - received));
+          if (!read_exact(fd, &text[received], text.size() - received))
+            return;
+        }
+
+        std::string key, error;
+        bool ok = scenes.load(text, key, error);
+        if (!write_line(fd, ok ? "OK " + key : "ERROR " + error))
+          return;
+      }
+      else if (command == "RENDER")
+      {
+        render_job job;
+        std::string error;
+        bool ok;
+        if (!parse_render_job(line, job, error))
+          ok = write_line(fd, "ERROR invalid render job: " + error);
+        else
+          ok = render(fd, job);
+        if (!ok)
+          return;
+      }
+      else if (command == "QUIT")
+      {
+        return;
+      }
+      else if (!write_line(fd, "ERROR unknown command " + command))
+      {
+        return;
+      }
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "connection closed: " << e.what() << std::endl;
+  }
+}
+
+bool render_server::render(int fd, const render_job& job)
+{
+  auto world = scenes.find(job.scene);
+  if (!world)
+    return write_line(fd, "ERROR unknown scene " + job.scene);
+
+  camera cam(job.lookfrom, job.lookat, job.vup, job.vfov, double(job.width) / job.height, job.aperture,
+             job.focus_dist);
+
+  std::vector<std::pair<int, int>> tiles;
+  for (int y = job.y0; y < job.y1; y += tile_size)
+    for (int x = job.x0; x < job.x1; x += tile_size)
+      tiles.push_back(std::make_pair(x, y));
+
+  // the pool tasks only render: they queue their tile, which this thread writes to the connection.
+  // Only a few tiles of a job are in flight at a time, so a client that does not read its tiles
+  // holds at most that many pool tasks and the jobs of the other connections keep being rendered.
+  struct rendered_tile
+  {
+    int x, y, width, height;
+    std::vector<unsigned char> pixels;
+  };
+  struct tile_queue
+  {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<rendered_tile> tiles;
+    // set when the client is gone, the tiles still in flight are dropped
+    bool cancelled = false;
+  };
+  auto queue = make_shared<tile_queue>();
+  const std::size_t max_in_flight = 2 * pool.size();
+
+  std::size_t submitted = 0, in_flight = 0;
+  bool ok = true;
+  for (std::size_t written = 0; ok && written < tiles.size(); written++)
+  {
+    for (; submitted < tiles.size() && in_flight < max_in_flight; submitted++, in_flight++)
+    {
+      auto tile = tiles[submitted];
+      pool.submit([=] {
+        {
+          std::lock_guard<std::mutex> lock(queue->mutex);
+          if (queue->cancelled)
+            return;
+        }
+        rendered_tile done;
+        done.x = tile.first;
+        done.y = tile.second;
+        done.width = std::min(tile.first + tile_size, job.x1) - tile.first;
+        done.height = std::min(tile.second + tile_size, job.y1) - tile.second;
+        render_tile(*world, cam, job, done.x, done.y, done.x + done.width, done.y + done.height, done.pixels);
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (!queue->cancelled)
+        {
+          queue->tiles.push_back(std::move(done));
+          queue->ready.notify_one();
+        }
+      });
+    }
+
+    rendered_tile done;
+    {
+      std::unique_lock<std::mutex> lock(queue->mutex);
+      queue->ready.wait(lock, [&] { return !queue->tiles.empty(); });
+      done = std::move(queue->tiles.front());
+      queue->tiles.pop_front();
+    }
+    in_flight--;
+
+    std::ostringstream header;
+    header << "TILE " << done.x << ' ' << done.y << ' ' << done.width << ' ' << done.height;
+    ok = write_line(fd, header.str()) && write_all(fd, done.pixels.data(), done.pixels.size());
+  }
+
+  if (!ok)
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->cancelled = true;
+    return false;
+  }
+
+  auto texture_stats = scenes.texture_stats();
+  if (texture_stats.misses > 0)
+    std::cerr << "texture cache: hit rate " << 100 * texture_stats.hit_rate() << "%, "
+              << texture_stats.resident_bytes / (1024.0 * 1024.0) << " MiB resident" << std::endl;
+  return write_line(fd, "DONE");
+}
+
+// entry point of the server mode
+int run_render_server(const std::string& socket_path)
+{
+  render_server server(socket_path);
+  return server.run();
+}
+
+#endif /* INCLUDE_RENDER_SERVER_HPP_ */
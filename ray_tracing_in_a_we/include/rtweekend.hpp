@@ -1,6 +1,7 @@
 #ifndef INCLUDE_RTWEEKEND_HPP_
 #define INCLUDE_RTWEEKEND_HPP_
 
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <limits>
@@ -23,8 +24,10 @@ const double pi = 3.1415926535897932385;
 inline double random_double()
 {
   // Returns a random real in [0,1).
-  static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-  static std::mt19937 generator;
+  // Every thread has its own generator; the first thread uses the default seed.
+  static std::atomic<unsigned> next_seed(std::mt19937::default_seed);
+  thread_local std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  thread_local std::mt19937 generator(next_seed++);
   return distribution(generator);
 }
 
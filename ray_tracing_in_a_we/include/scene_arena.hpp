@@ -0,0 +1,356 @@
+#ifndef INCLUDE_SCENE_ARENA_HPP_
+#define INCLUDE_SCENE_ARENA_HPP_
+
+#include "bvh.hpp"
+#include "hittable.hpp"
+#include "light_list.hpp"
+#include "material.hpp"
+#include "sphere.hpp"
+#include "texture.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// typed_pool stores objects of a single type in contiguous blocks.
+// The address of an object never changes once it has been created, so the pool
+// can hand out plain pointers that stay valid until the pool is cleared.
+template <typename T>
+class typed_pool
+{
+public:
+  explicit typed_pool(std::size_t block_size = 4096) : block_size(block_size), current(0), count(0)
+  {
+  }
+  typed_pool(const typed_pool&) = delete;
+  typed_pool& operator=(const typed_pool&) = delete;
+  ~typed_pool()
+  {
+    clear();
+  }
+
+  // construct a new object at the end of the pool and return its address
+  template <typename... Args>
+  T* emplace(Args&&... args)
+  {
+    while (current < blocks.size() && blocks[current].used == blocks[current].capacity)
+      current++;
+    if (current == blocks.size())
+      add_block(block_size);
+
+    block& b = blocks[current];
+    T* obj = new (b.data + b.used) T(std::forward<Args>(args)...);
+    b.used++;
+    count++;
+    return obj;
+  }
+
+  // make room for n objects in total, using a single block for the missing part
+  void reserve(std::size_t n)
+  {
+    std::size_t cap = capacity();
+    if (n > cap)
+      add_block(n - cap);
+  }
+
+  // destroy every object and release all the blocks at once
+  void clear()
+  {
+    for (auto& b : blocks)
+    {
+      if (!std::is_trivially_destructible<T>::value)
+        for (std::size_t i = 0; i < b.used; i++)
+          b.data[i].~T();
+      ::operator delete(b.data);
+    }
+    blocks.clear();
+    current = 0;
+    count = 0;
+  }
+
+  // call f on every object, in insertion order
+  template <typename F>
+  void for_each(F f) const
+  {
+    for (const auto& b : blocks)
+      for (std::size_t i = 0; i < b.used; i++)
+        f(b.data[i]);
+  }
+
+  // true if pred holds for at least one object, stops at the first one
+  template <typename P>
+  bool any_of(P pred) const
+  {
+    for (const auto& b : blocks)
+      for (std::size_t i = 0; i < b.used; i++)
+        if (pred(b.data[i]))
+          return true;
+    return false;
+  }
+
+  std::size_t size() const
+  {
+    return count;
+  }
+
+  std::size_t capacity() const
+  {
+    std::size_t cap = 0;
+    for (const auto& b : blocks)
+      cap += b.capacity;
+    return cap;
+  }
+
+  // bytes allocated by the pool
+  std::size_t bytes() const
+  {
+    return capacity() * sizeof(T);
+  }
+
+private:
+  struct block
+  {
+    T* data;
+    std::size_t used;
+    std::size_t capacity;
+  };
+
+  void add_block(std::size_t n)
+  {
+    block b;
+    b.data = static_cast<T*>(::operator new(n * sizeof(T)));
+    b.used = 0;
+    b.capacity = n;
+    blocks.push_back(b);
+  }
+
+  std::size_t block_size;
+  std::size_t current;  // first block that may still have free slots
+  std::size_t count;
+  std::vector<block> blocks;
+};
+
+// scene_arena owns every primitive and material of a scene.
+// Objects are grouped by type in typed pools and referenced through plain pointers,
+// so building and tracing the scene never touches a reference count.
+// Everything is released in bulk when the arena is cleared or destroyed.
+// The class is final, so that the calls of the render kernels through a scene_arena are not virtual.
+class scene_arena final : public hittable
+{
+public:
+  scene_arena()
+  {
+  }
+  scene_arena(const scene_arena&) = delete;
+  scene_arena& operator=(const scene_arena&) = delete;
+
+  const lambertian* make_lambertian(const color& albedo)
+  {
+    return lambertians.emplace(albedo);
+  }
+  const lambertian* make_lambertian(const texture* albedo)
+  {
+    return lambertians.emplace(albedo);
+  }
+  const metal* make_metal(const color& albedo, double fuzz)
+  {
+    return metals.emplace(albedo, fuzz);
+  }
+  const metal* make_metal(const texture* albedo, double fuzz)
+  {
+    return metals.emplace(albedo, fuzz);
+  }
+  const dielectric* make_dielectric(double index_of_refraction)
+  {
+    return dielectrics.emplace(index_of_refraction);
+  }
+  const diffuse_light* make_diffuse_light(const color& emit)
+  {
+    return diffuse_lights.emplace(emit);
+  }
+
+  // the cache, which holds the texels, must outlive the arena
+  const image_texture* make_image_texture(const texture_cache& cache, const tiled_texture& file)
+  {
+    return image_textures.emplace(cache, file);
+  }
+
+  // spheres with an emissive material are also registered as lights
+  const sphere* add_sphere(const point3& center, double radius, const material* m)
+  {
+    const sphere* s = spheres.emplace(center, radius, m);
+    accelerator.reset();
+    if (m->is_emissive())
+      emitters.add(s);
+    return s;
+  }
+
+  // preallocate room for n spheres so that a large scene is built without reallocations
+  void reserve(std::size_t n)
+  {
+    spheres.reserve(n);
+  }
+
+  // builds a bvh over the spheres, hit and occluded use it until the next sphere is added
+  void build_bvh(const bvh_options& options = bvh_options());
+
+  // the bvh of the scene, null until build_bvh is called
+  const bvh* acceleration() const
+  {
+    return accelerator.get();
+  }
+
+  // builds a copy of the scene in copy, which must be empty.
+  // The memory of the copy is first touched by the calling thread, so a thread pinned
+  // to a NUMA node gets a replica of the scene in the memory of that node.
+  // The bvh, if any, is copied on the calling thread as well.
+  void copy_to(scene_arena& copy) const;
+
+  void clear()
+  {
+    spheres.clear();
+    lambertians.clear();
+    metals.clear();
+    dielectrics.clear();
+    diffuse_lights.clear();
+    image_textures.clear();
+    emitters.clear();
+    accelerator.reset();
+  }
+
+  // the emissive spheres of the scene
+  const light_list& lights() const
+  {
+    return emitters;
+  }
+
+  // the material_bit of every kind of material in the scene
+  unsigned material_kinds() const
+  {
+    unsigned kinds = 0;
+    if (lambertians.size() > 0)
+      kinds |= material_bit(material_kind::lambertian);
+    if (metals.size() > 0)
+      kinds |= material_bit(material_kind::metal);
+    if (dielectrics.size() > 0)
+      kinds |= material_bit(material_kind::dielectric);
+    if (diffuse_lights.size() > 0)
+      kinds |= material_bit(material_kind::diffuse_light);
+    return kinds;
+  }
+
+  // number of primitives in the scene
+  std::size_t size() const
+  {
+    return spheres.size();
+  }
+
+  // bytes allocated for primitives, materials, textures and the bvh (the texels are in the texture cache)
+  std::size_t bytes() const
+  {
+    return spheres.bytes() + lambertians.bytes() + metals.bytes() + dielectrics.bytes() + diffuse_lights.bytes() +
+           image_textures.bytes() + (accelerator ? accelerator->bytes() : 0);
+  }
+
+  virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+  virtual bool occluded(const ray& r, double t_min, double t_max) const override;
+  virtual bool bounding_box(aabb& output_box) const override;
+
+private:
+  typed_pool<sphere> spheres;
+  typed_pool<lambertian> lambertians;
+  typed_pool<metal> metals;
+  typed_pool<dielectric> dielectrics;
+  typed_pool<diffuse_light> diffuse_lights;
+  typed_pool<image_texture> image_textures;
+  light_list emitters;
+  std::unique_ptr<bvh> accelerator;
+};
+
+bool scene_arena::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
+{
+  if (accelerator)
+    return accelerator->bvh::hit(r, t_min, t_max, rec);
+
+  hit_record temp_rec;
+  bool hit_anything = false;
+  auto closest_so_far = t_max;
+
+  // the spheres are stored by value, so the call is resolved statically
+  spheres.for_each([&](const sphere& s) {
+    if (s.sphere::hit(r, t_min, closest_so_far, temp_rec))
+    {
+      hit_anything = true;
+      closest_so_far = temp_rec.t;
+      rec = temp_rec;
+    }
+  });
+  return hit_anything;
+}
+
+void scene_arena::copy_to(scene_arena& copy) const
+{
+  std::unordered_map<const texture*, const texture*> texture_replica;
+  texture_replica[nullptr] = nullptr;
+  image_textures.for_each([&](const image_texture& t) { texture_replica[&t] = copy.image_textures.emplace(t); });
+
+  std::unordered_map<const material*, const material*> replica;
+  lambertians.for_each([&](const lambertian& m) {
+    lambertian* l = copy.lambertians.emplace(m);
+    l->albedo_texture = texture_replica.at(m.albedo_texture);
+    replica[&m] = l;
+  });
+  metals.for_each([&](const metal& m) {
+    metal* c = copy.metals.emplace(m);
+    c->albedo_texture = texture_replica.at(m.albedo_texture);
+    replica[&m] = c;
+  });
+  dielectrics.for_each([&](const dielectric& m) { replica[&m] = copy.dielectrics.emplace(m); });
+  diffuse_lights.for_each([&](const diffuse_light& m) { replica[&m] = copy.diffuse_lights.emplace(m); });
+
+  copy.reserve(spheres.size());
+  spheres.for_each([&](const sphere& s) { copy.add_sphere(s.center, s.radius, replica.at(s.mat_ptr)); });
+
+  // the bvh is copied rather than rebuilt, its materials mapped to those of the copy
+  if (accelerator)
+  {
+    copy.accelerator.reset(new bvh(*accelerator));
+    for (auto& p : copy.accelerator->primitives)
+      p.mat_ptr = replica.at(p.mat_ptr);
+  }
+}
+
+void scene_arena::build_bvh(const bvh_options& options)
+{
+  std::vector<const sphere*> objects;
+  objects.reserve(spheres.size());
+  spheres.for_each([&](const sphere& s) { objects.push_back(&s); });
+  accelerator.reset(new bvh(objects, options));
+}
+
+bool scene_arena::bounding_box(aabb& output_box) const
+{
+  if (accelerator)
+    return accelerator->bvh::bounding_box(output_box);
+
+  output_box = aabb();
+  aabb temp_box;
+  spheres.for_each([&](const sphere& s) {
+    s.sphere::bounding_box(temp_box);
+    output_box.extend(temp_box);
+  });
+  return spheres.size() > 0;
+}
+
+bool scene_arena::occluded(const ray& r, double t_min, double t_max) const
+{
+  if (accelerator)
+    return accelerator->bvh::occluded(r, t_min, t_max);
+  return spheres.any_of([&](const sphere& s) { return s.sphere::occluded(r, t_min, t_max); });
+}
+
+#endif /* INCLUDE_SCENE_ARENA_HPP_ */
@@ -0,0 +1,164 @@
+#ifndef INCLUDE_SCENE_LOADER_HPP_
+#define INCLUDE_SCENE_LOADER_HPP_
+
+#include "rtweekend.hpp"
+
+#include "material.hpp"
+#include "scene_arena.hpp"
+#include "texture_cache.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <string>
+
+/*
+ *  Text description of a scene, one statement per line ('#' starts a comment):
+ *
+ *    texture <name> <path of a tiled texture file>
+ *    material <name> lambertian <r> <g> <b>
+ *    material <name> lambertian texture <texture name>
+ *    material <name> metal <r> <g> <b> <fuzz>
+ *    material <name> metal texture <texture name> <fuzz>
+ *    material <name> dielectric <index_of_refraction>
+ *    material <name> diffuse_light <r> <g> <b>
+ *    sphere <x> <y> <z> <radius> <material name>
+ *
+ *  A texture must be declared before the materials that use it,
+ *  and a material before the spheres that use it.
+ */
+
+// 64 bit FNV-1a hash of a scene description, as 16 hexadecimal digits.
+// Two requests with the same text share the same cached scene.
+std::string scene_hash(const std::string& text)
+{
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : text)
+  {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  char digits[17];
+  std::snprintf(digits, sizeof(digits), "%016llx", static_cast<unsigned long long>(hash));
+  return digits;
+}
+
+// fills world with the scene described by text, its textures are opened in textures.
+// On error, returns false and sets error to a message with the line number.
+bool load_scene(const std::string& text, scene_arena& world, std::string& error, texture_cache* textures = nullptr)
+{
+  std::map<std::string, const material*> materials;
+  std::map<std::string, const texture*> texture_names;
+  std::istringstream in(text);
+  std::string line;
+  int line_number = 0;
+
+  while (std::getline(in, line))
+  {
+    line_number++;
+    auto comment = line.find('#');
+    if (comment != std::string::npos)
+      line.erase(comment);
+
+    std::istringstream statement(line);
+    std::string keyword;
+    if (!(statement >> keyword))
+      continue;  // empty line
+
+    bool ok = false;
+    if (keyword == "texture")
+    {
+      std::string name, path;
+      if (statement >> name >> path)
+      {
+        if (!textures)
+        {
+          error = "line " + std::to_string(line_number) + ": textures are not available";
+          return false;
+        }
+        const tiled_texture* file = textures->open(path, error);
+        if (!file)
+        {
+          error = "line " + std::to_string(line_number) + ": " + error;
+          return false;
+        }
+        texture_names[name] = world.make_image_texture(*textures, *file);
+        ok = true;
+      }
+    }
+    else if (keyword == "material")
+    {
+      std::string name, type, word;
+      double r, g, b, param;
+      const material* m = nullptr;
+      if (statement >> name >> type)
+      {
+        // "texture <texture name>" instead of a color
+        const texture* albedo = nullptr;
+        auto color_start = statement.tellg();
+        if ((type == "lambertian" || type == "metal") && statement >> word && word == "texture")
+        {
+          auto t = statement >> word ? texture_names.find(word) : texture_names.end();
+          if (t == texture_names.end())
+          {
+            error = "line " + std::to_string(line_number) + ": unknown texture '" + word + "'";
+            return false;
+          }
+          albedo = t->second;
+        }
+        else
+        {
+          statement.clear();
+          statement.seekg(color_start);
+        }
+
+        if (albedo)
+        {
+          if (type == "lambertian")
+            m = world.make_lambertian(albedo);
+          else if (statement >> param)
+            m = world.make_metal(albedo, param);
+        }
+        else if (type == "lambertian" && statement >> r >> g >> b)
+          m = world.make_lambertian(color(r, g, b));
+        else if (type == "metal" && statement >> r >> g >> b >> param)
+          m = world.make_metal(color(r, g, b), param);
+        else if (type == "dielectric" && statement >> param)
+          m = world.make_dielectric(param);
+        else if (type == "diffuse_light" && statement >> r >> g >> b)
+          m = world.make_diffuse_light(color(r, g, b));
+      }
+      if (m)
+      {
+        materials[name] = m;
+        ok = true;
+      }
+    }
+    else if (keyword == "sphere")
+    {
+      double x, y, z, radius;
+      std::string name;
+      if (statement >> x >> y >> z >> radius >> name)
+      {
+        auto m = materials.find(name);
+        if (m == materials.end())
+        {
+          error = "line " + std::to_string(line_number) + ": unknown material '" + name + "'";
+          return false;
+        }
+        world.add_sphere(point3(x, y, z), radius, m->second);
+        ok = true;
+      }
+    }
+
+    if (!ok)
+    {
+      error = "line " + std::to_string(line_number) + ": cannot parse '" + line + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif /* INCLUDE_SCENE_LOADER_HPP_ */
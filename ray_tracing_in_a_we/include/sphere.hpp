@@ -2,22 +2,59 @@
 #define INCLUDE_SPHERE_HPP_
 
 #include "hittable.hpp"
+#include "onb.hpp"
 
 class sphere : public hittable
 {
 public:
   sphere();
-  sphere(point3 cen, double r, shared_ptr<material> m) : center(cen), radius(r), mat_ptr(m){};
+  // the material is not owned by the sphere, it must outlive it (see scene_arena)
+  sphere(point3 cen, double r, const material* m) : center(cen), radius(r), mat_ptr(m){};
 
   virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+  virtual bool occluded(const ray& r, double t_min, double t_max) const override;
+  virtual bool bounding_box(aabb& output_box) const override;
+
+  // the tests of hit() and occluded() for a sphere given by its fields,
+  // shared with the spheres stored without a sphere object (see bvh)
+  static bool hit_sphere(const point3& center, double radius, const material* mat_ptr, const ray& r, double t_min,
+                         double t_max, hit_record& rec);
+  static bool occluded_by_sphere(const point3& center, double radius, const ray& r, double t_min, double t_max);
+
+  // density (over solid angle) of the directions returned by random(o)
+  double pdf_value(const point3& o, const vec3& v) const;
+  // random direction from o towards the sphere, uniform in the cone that the sphere subtends
+  vec3 random(const point3& o) const;
+
+  // the surface coordinates of a point p of the unit sphere centered at the origin:
+  // u is the angle around the Y axis from X = -1, v the angle from Y = -1 to Y = +1, both scaled to [0, 1]
+  static void get_sphere_uv(const point3& p, double& u, double& v)
+  {
+    // p is computed as (hit point - center) / radius, |p.y()| can round to slightly more than 1 at the poles
+    auto theta = acos(-clamp(p.y(), -1.0, 1.0));
+    auto phi = atan2(-p.z(), p.x()) + pi;
+    u = phi / (2 * pi);
+    v = theta / pi;
+  }
 
 public:
   point3 center;
   double radius;
-  shared_ptr<material> mat_ptr;
+  const material* mat_ptr;
 };
 
 bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
+{
+  return hit_sphere(center, radius, mat_ptr, r, t_min, t_max, rec);
+}
+
+bool sphere::occluded(const ray& r, double t_min, double t_max) const
+{
+  return occluded_by_sphere(center, radius, r, t_min, t_max);
+}
+
+bool sphere::hit_sphere(const point3& center, double radius, const material* mat_ptr, const ray& r, double t_min,
+                        double t_max, hit_record& rec)
 {
   // the ray is defined by the equation r(t) = A + t * B
   // where A is the origin of the ray and B is the direction of the ray
@@ -72,9 +109,73 @@ bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) cons
   rec.p = r.at(rec.t);
   vec3 outward_normal = (rec.p - center) / radius;
   rec.set_face_normal(r, outward_normal);
+  get_sphere_uv(outward_normal, rec.u, rec.v);
+  // v spans half a great circle, pi * radius
+  rec.footprint = r.spread * rec.t * r.direction().length() / (pi * radius);
   rec.mat_ptr = mat_ptr;
 
   return true;
 }
 
+bool sphere::occluded_by_sphere(const point3& center, double radius, const ray& r, double t_min, double t_max)
+{
+  // same test as hit_sphere(), without filling a hit_record
+  vec3 oc = r.origin() - center;
+  auto a = r.direction().length_squared();
+  auto half_b = dot(oc, r.direction());
+  auto c = oc.length_squared() - radius * radius;
+
+  auto discriminant = half_b * half_b - a * c;
+  if (discriminant < 0)
+    return false;
+  auto sqrtd = sqrt(discriminant);
+
+  auto root = (-half_b - sqrtd) / a;
+  if (t_min <= root && root <= t_max)
+    return true;
+  root = (-half_b + sqrtd) / a;
+  return t_min <= root && root <= t_max;
+}
+
+bool sphere::bounding_box(aabb& output_box) const
+{
+  vec3 extent(radius, radius, radius);
+  output_box = aabb(center - extent, center + extent);
+  return true;
+}
+
+double sphere::pdf_value(const point3& o, const vec3& v) const
+{
+  auto distance_squared = (center - o).length_squared();
+  // no cone if the origin is inside the sphere
+  if (distance_squared <= radius * radius)
+    return 0;
+  if (!occluded(ray(o, v), 0.001, infinity))
+    return 0;
+
+  auto cos_theta_max = sqrt(1 - radius * radius / distance_squared);
+  auto solid_angle = 2 * pi * (1 - cos_theta_max);
+  return 1 / solid_angle;
+}
+
+vec3 sphere::random(const point3& o) const
+{
+  vec3 direction = center - o;
+  auto distance_squared = direction.length_squared();
+  if (distance_squared <= radius * radius)
+    return random_unit_vector();
+
+  // z is the cosine of the angle with the axis of the cone, uniform in [cos_theta_max, 1]
+  auto r1 = random_double();
+  auto r2 = random_double();
+  auto z = 1 + r2 * (sqrt(1 - radius * radius / distance_squared) - 1);
+  auto phi = 2 * pi * r1;
+  auto x = cos(phi) * sqrt(1 - z * z);
+  auto y = sin(phi) * sqrt(1 - z * z);
+
+  onb uvw;
+  uvw.build_from_w(direction);
+  return uvw.local(x, y, z);
+}
+
 #endif /* INCLUDE_SPHERE_HPP_ */
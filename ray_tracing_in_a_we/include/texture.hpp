@@ -0,0 +1,33 @@
+#ifndef INCLUDE_TEXTURE_HPP_
+#define INCLUDE_TEXTURE_HPP_
+
+#include "rtweekend.hpp"
+
+#include "texture_cache.hpp"
+
+// a color that varies over a surface
+class texture
+{
+public:
+  // the color at the surface coordinates (u, v) of the point p, averaged over a footprint in uv units
+  virtual color value(double u, double v, const point3& p, double footprint) const = 0;
+};
+
+// a texture read from a tiled texture file through a texture cache (neither is owned)
+class image_texture : public texture
+{
+public:
+  image_texture(const texture_cache& cache, const tiled_texture& file) : cache(&cache), file(&file)
+  {
+  }
+
+  virtual color value(double u, double v, const point3& p, double footprint) const override
+  {
+    return cache->sample(*file, u, v, footprint);
+  }
+
+  const texture_cache* cache;
+  const tiled_texture* file;
+};
+
+#endif /* INCLUDE_TEXTURE_HPP_ */
@@ -0,0 +1,472 @@
+#ifndef INCLUDE_TEXTURE_CACHE_HPP_
+#define INCLUDE_TEXTURE_CACHE_HPP_
+
+#include "rtweekend.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ *  Image textures too large to be held in memory together.
+ *
+ *  A texture is stored on disk as a tiled MIP pyramid (make_tiled_texture converts a PPM image):
+ *  a header followed by the tiles of every level, from the full resolution level down to 1x1,
+ *  each level in row-major order of its tiles. A tile holds tile_size x tile_size 8 bit RGB texels,
+ *  the tiles on the right and bottom edges are padded by repeating the last texel.
+ *
+ *  texture_cache reads the tiles from disk on first use and keeps them under a memory budget,
+ *  evicting the least recently used ones. The tiles are spread over independently locked shards,
+ *  so concurrent lookups rarely wait on each other, and are read from disk outside of any lock.
+ *  Every shard keeps its own LRU order but the budget is shared: the resident bytes exceed it
+ *  by at most the tiles being inserted at that moment, one per thread reading a tile.
+ */
+
+// the header of a tiled texture file
+struct tiled_texture_header
+{
+  char magic[8];
+  std::int32_t width;
+  std::int32_t height;
+  std::int32_t tile_size;
+  std::int32_t levels;
+};
+
+const char tiled_texture_magic[8] = "RTTILE1";
+
+// the size of a tile in bytes must fit in an int
+inline bool valid_tile_size(int tile_size)
+{
+  return tile_size > 0 && 3LL * tile_size * tile_size <= INT_MAX;
+}
+
+// reads a binary (P6) or ASCII (P3) PPM image with 8 bit channels.
+// On error, returns false and sets error.
+bool read_ppm(const std::string& path, int& width, int& height, std::vector<unsigned char>& rgb, std::string& error)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+  {
+    error = "cannot open '" + path + "'";
+    return false;
+  }
+
+  // the header fields are separated by whitespace and comments
+  auto next_field = [&](int& value) {
+    while (in >> std::ws && in.peek() == '#')
+      in.ignore(1 << 20, '\n');
+    return static_cast<bool>(in >> value);
+  };
+  std::string magic;
+  int max_value;
+  in >> magic;
+  if ((magic != "P6" && magic != "P3") || !next_field(width) || !next_field(height) || !next_field(max_value) ||
+      width <= 0 || height <= 0 || max_value != 255)
+  {
+    error = "'" + path + "' is not an 8 bit PPM image";
+    return false;
+  }
+
+  rgb.resize(3 * static_cast<std::size_t>(width) * height);
+  if (magic == "P6")
+  {
+    in.get();  // the single whitespace after the header
+    in.read(reinterpret_cast<char*>(rgb.data()), rgb.size());
+  }
+  else
+  {
+    int value = 0;
+    for (auto& c : rgb)
+      if (in >> value)
+        c = static_cast<unsigned char>(value);
+  }
+  if (!in)
+  {
+    error = "'" + path + "' is truncated";
+    return false;
+  }
+  return true;
+}
+
+// writes the tiled MIP pyramid of an RGB image to path.
+// Every level is half the size of the previous one (rounded down), each texel the mean of 2x2 texels.
+bool write_tiled_texture(const std::string& path, int width, int height, const std::vector<unsigned char>& rgb,
+                         int tile_size, std::string& error)
+{
+  if (!valid_tile_size(tile_size))
+  {
+    error = "invalid tile size " + std::to_string(tile_size);
+    return false;
+  }
+  std::ofstream out(path, std::ios::binary);
+  if (!out)
+  {
+    error = "cannot create '" + path + "'";
+    return false;
+  }
+
+  int levels = 1;
+  while ((width >> (levels - 1)) > 1 || (height >> (levels - 1)) > 1)
+    levels++;
+
+  tiled_texture_header header;
+  std::memcpy(header.magic, tiled_texture_magic, sizeof(header.magic));
+  header.width = width;
+  header.height = height;
+  header.tile_size = tile_size;
+  header.levels = levels;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  std::vector<unsigned char> level = rgb;
+  std::vector<unsigned char> tile(3 * tile_size * tile_size);
+  int w = width, h = height;
+  for (int l = 0; l < levels; l++)
+  {
+    for (int ty = 0; ty < (h + tile_size - 1) / tile_size; ty++)
+      for (int tx = 0; tx < (w + tile_size - 1) / tile_size; tx++)
+      {
+        for (int y = 0; y < tile_size; y++)
+          for (int x = 0; x < tile_size; x++)
+          {
+            int sx = std::min(tx * tile_size + x, w - 1);
+            int sy = std::min(ty * tile_size + y, h - 1);
+            std::memcpy(&tile[3 * (y * tile_size + x)], &level[3 * (static_cast<std::size_t>(sy) * w + sx)], 3);
+          }
+        out.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+      }
+
+    // next level
+    int next_w = std::max(w / 2, 1), next_h = std::max(h / 2, 1);
+    std::vector<unsigned char> next(3 * static_cast<std::size_t>(next_w) * next_h);
+    for (int y = 0; y < next_h; y++)
+      for (int x = 0; x < next_w; x++)
+        for (int c = 0; c < 3; c++)
+        {
+          int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+          int y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+          int sum = level[3 * (static_cast<std::size_t>(y0) * w + x0) + c] +
+                    level[3 * (static_cast<std::size_t>(y0) * w + x1) + c] +
+                    level[3 * (static_cast<std::size_t>(y1) * w + x0) + c] +
+                    level[3 * (static_cast<std::size_t>(y1) * w + x1) + c];
+          next[3 * (static_cast<std::size_t>(y) * next_w + x) + c] = static_cast<unsigned char>((sum + 2) / 4);
+        }
+    level.swap(next);
+    w = next_w;
+    h = next_h;
+  }
+
+  if (!out)
+  {
+    error = "cannot write '" + path + "'";
+    return false;
+  }
+  return true;
+}
+
+// converts a PPM image to a tiled texture file
+bool make_tiled_texture(const std::string& ppm_path, const std::string& path, int tile_size, std::string& error)
+{
+  int width, height;
+  std::vector<unsigned char> rgb;
+  return read_ppm(ppm_path, width, height, rgb, error) &&
+         write_tiled_texture(path, width, height, rgb, tile_size, error);
+}
+
+// an open tiled texture file
+struct tiled_texture
+{
+  int fd;
+  int width;
+  int height;
+  int tile_size;
+  int levels;
+  // for every level: its size, its number of tiles per row and the file offset of its first tile
+  std::vector<int> level_width;
+  std::vector<int> level_height;
+  std::vector<int> tiles_x;
+  std::vector<off_t> level_offset;
+};
+
+struct texture_cache_stats
+{
+  std::uint64_t hits;
+  std::uint64_t misses;
+  std::uint64_t evictions;
+  std::size_t resident_bytes;
+  // the most bytes resident at once, the budget plus at most a tile per thread
+  std::size_t peak_resident_bytes;
+  std::size_t budget_bytes;
+
+  double hit_rate() const
+  {
+    return hits + misses > 0 ? double(hits) / (hits + misses) : 0;
+  }
+};
+
+class texture_cache
+{
+public:
+  explicit texture_cache(std::size_t budget_bytes) : budget(budget_bytes)
+  {
+  }
+  texture_cache(const texture_cache&) = delete;
+  texture_cache& operator=(const texture_cache&) = delete;
+
+  ~texture_cache()
+  {
+    for (const auto& t : textures)
+      close(t->fd);
+  }
+
+  // opens a tiled texture file and reads its header, its tiles are read on first use.
+  // A file is opened once however many times it is requested.
+  // On error, returns nullptr and sets error.
+  const tiled_texture* open(const std::string& path, std::string& error);
+
+  // the bilinearly filtered texture at (u, v), in the level whose texels are about footprint wide
+  // (in uv units, 0 for the full resolution). u wraps around, v is clamped; v = 1 is the top row.
+  // The texels are converted from gamma 2 to linear values.
+  color sample(const tiled_texture& t, double u, double v, double footprint) const;
+
+  texture_cache_stats stats() const;
+
+private:
+  using tile_ptr = std::shared_ptr<const std::vector<unsigned char>>;
+
+  // a tile, read from disk if it is not resident
+  tile_ptr fetch(const tiled_texture& t, int level, int tx, int ty) const;
+
+  struct tile_key
+  {
+    const tiled_texture* texture;
+    int level;
+    int tx;
+    int ty;
+
+    bool operator==(const tile_key& other) const
+    {
+      return texture == other.texture && level == other.level && tx == other.tx && ty == other.ty;
+    }
+  };
+  struct tile_key_hash
+  {
+    std::size_t operator()(const tile_key& key) const
+    {
+      std::uint64_t h = reinterpret_cast<std::uintptr_t>(key.texture);
+      h = (h ^ static_cast<std::uint64_t>(key.level)) * 0x9e3779b97f4a7c15ULL;
+      h = (h ^ static_cast<std::uint64_t>(key.tx)) * 0x9e3779b97f4a7c15ULL;
+      h = (h ^ static_cast<std::uint64_t>(key.ty)) * 0x9e3779b97f4a7c15ULL;
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+  };
+
+  // the tiles of a shard, most recently used first
+  struct shard
+  {
+    std::mutex mutex;
+    std::list<tile_key> lru;
+    std::unordered_map<tile_key, std::pair<tile_ptr, std::list<tile_key>::iterator>, tile_key_hash> tiles;
+  };
+  static const int n_shards = 64;
+
+  // evicts the least recently used tile of a locked shard
+  void evict_least_recent(shard& s) const;
+
+  const std::size_t budget;
+  mutable shard shards[n_shards];
+  mutable std::atomic<std::uint64_t> hits{ 0 };
+  mutable std::atomic<std::uint64_t> misses{ 0 };
+  mutable std::atomic<std::uint64_t> evictions{ 0 };
+  mutable std::atomic<std::size_t> resident{ 0 };
+  mutable std::atomic<std::size_t> peak_resident{ 0 };
+
+  std::mutex open_mutex;
+  std::map<std::string, const tiled_texture*> opened;
+  std::vector<std::unique_ptr<tiled_texture>> textures;
+};
+
+const tiled_texture* texture_cache::open(const std::string& path, std::string& error)
+{
+  std::lock_guard<std::mutex> lock(open_mutex);
+  auto it = opened.find(path);
+  if (it != opened.end())
+    return it->second;
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    error = "cannot open '" + path + "'";
+    return nullptr;
+  }
+  tiled_texture_header header;
+  if (pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+      std::memcmp(header.magic, tiled_texture_magic, sizeof(header.magic)) != 0 || header.width <= 0 ||
+      header.height <= 0 || !valid_tile_size(header.tile_size) || header.levels <= 0 || header.levels > 32)
+  {
+    close(fd);
+    error = "'" + path + "' is not a tiled texture";
+    return nullptr;
+  }
+
+  std::unique_ptr<tiled_texture> t(new tiled_texture);
+  t->fd = fd;
+  t->width = header.width;
+  t->height = header.height;
+  t->tile_size = header.tile_size;
+  t->levels = header.levels;
+  off_t offset = sizeof(header);
+  int w = header.width, h = header.height;
+  for (int l = 0; l < header.levels; l++)
+  {
+    int tiles_x = (w + header.tile_size - 1) / header.tile_size;
+    int tiles_y = (h + header.tile_size - 1) / header.tile_size;
+    t->level_width.push_back(w);
+    t->level_height.push_back(h);
+    t->tiles_x.push_back(tiles_x);
+    t->level_offset.push_back(offset);
+    offset += static_cast<off_t>(tiles_x) * tiles_y * 3 * header.tile_size * header.tile_size;
+    w = std::max(w / 2, 1);
+    h = std::max(h / 2, 1);
+  }
+
+  const tiled_texture* result = t.get();
+  textures.push_back(std::move(t));
+  opened[path] = result;
+  return result;
+}
+
+texture_cache::tile_ptr texture_cache::fetch(const tiled_texture& t, int level, int tx, int ty) const
+{
+  tile_key key{ &t, level, tx, ty };
+  shard& s = shards[tile_key_hash()(key) % n_shards];
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.tiles.find(key);
+    if (it != s.tiles.end())
+    {
+      s.lru.splice(s.lru.begin(), s.lru, it->second.second);
+      hits.fetch_add(1, std::memory_order_relaxed);
+      return it->second.first;
+    }
+  }
+  misses.fetch_add(1, std::memory_order_relaxed);
+
+  // read outside the lock; a tile that cannot be read is black
+  const std::size_t tile_bytes = 3 * static_cast<std::size_t>(t.tile_size) * t.tile_size;
+  auto texels = std::make_shared<std::vector<unsigned char>>(tile_bytes);
+  off_t offset = t.level_offset[level] + (static_cast<off_t>(ty) * t.tiles_x[level] + tx) * tile_bytes;
+  for (std::size_t done = 0; done < tile_bytes;)
+  {
+    auto n = pread(t.fd, texels->data() + done, tile_bytes - done, offset + done);
+    if (n <= 0)
+      break;
+    done += n;
+  }
+
+  std::unique_lock<std::mutex> lock(s.mutex);
+  // another thread may have read the same tile meanwhile
+  auto it = s.tiles.find(key);
+  if (it != s.tiles.end())
+    return it->second.first;
+
+  s.lru.push_front(key);
+  s.tiles.emplace(key, std::make_pair(tile_ptr(texels), s.lru.begin()));
+  std::size_t now_resident = resident.fetch_add(tile_bytes, std::memory_order_relaxed) + tile_bytes;
+  std::size_t peak = peak_resident.load(std::memory_order_relaxed);
+  while (now_resident > peak && !peak_resident.compare_exchange_weak(peak, now_resident, std::memory_order_relaxed))
+  {
+  }
+
+  // the budget is global: the least recently used tiles of this shard are evicted first,
+  // except the tile just read, then those of the other shards.
+  // An evicted tile stays valid for the threads still sampling it.
+  while (resident.load(std::memory_order_relaxed) > budget && s.lru.size() > 1)
+    evict_least_recent(s);
+  lock.unlock();
+
+  // the other shards are locked one at a time, never together with this one
+  const int first = static_cast<int>(&s - shards);
+  for (int k = 1; k < n_shards && resident.load(std::memory_order_relaxed) > budget; k++)
+  {
+    shard& other = shards[(first + k) % n_shards];
+    std::lock_guard<std::mutex> other_lock(other.mutex);
+    while (resident.load(std::memory_order_relaxed) > budget && !other.lru.empty())
+      evict_least_recent(other);
+  }
+  return texels;
+}
+
+// the textures may have different tile sizes, so every tile is accounted for with its own size
+void texture_cache::evict_least_recent(shard& s) const
+{
+  auto evicted = s.tiles.find(s.lru.back());
+  std::size_t evicted_bytes = evicted->second.first->size();
+  s.tiles.erase(evicted);
+  s.lru.pop_back();
+  resident.fetch_sub(evicted_bytes, std::memory_order_relaxed);
+  evictions.fetch_add(1, std::memory_order_relaxed);
+}
+
+color texture_cache::sample(const tiled_texture& t, double u, double v, double footprint) const
+{
+  int level = 0;
+  if (footprint > 0)
+    level = static_cast<int>(clamp(std::floor(std::log2(footprint * t.height)), 0.0, t.levels - 1.0));
+  const int w = t.level_width[level], h = t.level_height[level];
+
+  // texel centers are at half integer coordinates
+  auto x = (u - std::floor(u)) * w - 0.5;
+  auto y = (1 - clamp(v, 0.0, 1.0)) * h - 0.5;
+  auto x0 = std::floor(x), y0 = std::floor(y);
+  auto fx = x - x0, fy = y - y0;
+
+  // the four texels often share a tile, which is then fetched once
+  std::uint64_t last_key = ~0ULL;
+  tile_ptr last_tile;
+  auto texel = [&](int tx, int ty) {
+    tx = ((tx % w) + w) % w;
+    ty = std::min(std::max(ty, 0), h - 1);
+    std::uint64_t key = static_cast<std::uint64_t>(ty / t.tile_size) << 32 | (tx / t.tile_size);
+    if (key != last_key)
+    {
+      last_tile = fetch(t, level, tx / t.tile_size, ty / t.tile_size);
+      last_key = key;
+    }
+    const unsigned char* c = &(*last_tile)[3 * ((ty % t.tile_size) * t.tile_size + tx % t.tile_size)];
+    // gamma 2, as written by write_color
+    auto r = c[0] / 255.0, g = c[1] / 255.0, b = c[2] / 255.0;
+    return color(r * r, g * g, b * b);
+  };
+
+  int ix = static_cast<int>(x0), iy = static_cast<int>(y0);
+  return (1 - fy) * ((1 - fx) * texel(ix, iy) + fx * texel(ix + 1, iy)) +
+         fy * ((1 - fx) * texel(ix, iy + 1) + fx * texel(ix + 1, iy + 1));
+}
+
+texture_cache_stats texture_cache::stats() const
+{
+  texture_cache_stats s;
+  s.hits = hits.load();
+  s.misses = misses.load();
+  s.evictions = evictions.load();
+  s.resident_bytes = resident.load();
+  s.peak_resident_bytes = peak_resident.load();
+  s.budget_bytes = budget;
+  return s;
+}
+
+#endif /* INCLUDE_TEXTURE_CACHE_HPP_ */
@@ -0,0 +1,102 @@
+#ifndef INCLUDE_THREAD_POOL_HPP_
+#define INCLUDE_THREAD_POOL_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// thread_pool runs the submitted tasks on a fixed set of worker threads, in submission order.
+class thread_pool
+{
+public:
+  explicit thread_pool(unsigned n_threads = std::thread::hardware_concurrency())
+  {
+    if (n_threads == 0)
+      n_threads = 1;
+    for (unsigned i = 0; i < n_threads; i++)
+      workers.emplace_back([this] { work(); });
+  }
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  // the queued tasks are still run before the workers are joined
+  ~thread_pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+      worker.join();
+  }
+
+  void submit(std::function<void()> task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+  }
+
+  std::size_t size() const
+  {
+    return workers.size();
+  }
+
+private:
+  void work()
+  {
+    while (true)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty())
+          return;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<std::function<void()>> tasks;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+};
+
+// splits [0, n) in n_chunks contiguous chunks and calls f(chunk, begin, end) for each of them,
+// on one thread per chunk when the range is large enough to pay for the threads
+template <typename F>
+void parallel_for(std::size_t n, unsigned n_chunks, F f)
+{
+  // below this size a range is processed on the calling thread
+  const std::size_t min_parallel_size = 4096;
+  if (n_chunks == 0)
+    n_chunks = 1;
+
+  auto chunk = [&](unsigned c) { f(c, n * c / n_chunks, n * (c + 1) / n_chunks); };
+  if (n_chunks == 1 || n < min_parallel_size)
+  {
+    for (unsigned c = 0; c < n_chunks; c++)
+      chunk(c);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  for (unsigned c = 1; c < n_chunks; c++)
+    threads.emplace_back(chunk, c);
+  chunk(0);
+  for (auto& thread : threads)
+    thread.join();
+}
+
+#endif /* INCLUDE_THREAD_POOL_HPP_ */
@@ -5,49 +5,23 @@
 #include "sphere.hpp"
 #include "camera.hpp"
 #include "material.hpp"
+#include "scene_arena.hpp"
+#include "integrator.hpp"
+#include "numa_render.hpp"
+#include "render_kernel.hpp"
+#include "render_server.hpp"
 
 #include <iostream>
-/*
- *  The ray_color function is the heart of the ray tracer.
- *  It takes a ray as input and returns a color.
- *  The ray_color function is called recursively to generate reflections and refractions.
- *  The ray_color function is also called for each pixel in the image to generate the final image.
- */
-color ray_color(const ray& r, const hittable& world, int depth)
-{
-  hit_record rec;
-
-  if (depth <= 0)
-    return color(0, 0, 0);  // if we've exceeded the ray bounce limit, no more light is gathered
-
-  if (world.hit(r, 0.001, infinity, rec))
-  {
-    // we compute the normal vector at the point of intersection
-    // the normal vector is a unit vector that points outward from the surface
-    // the normal vector is computed by subtracting the center of the sphere (0,0,-1)from the point of intersection
-    // r.at(t)
-    // in diffuse shading, we compute the color of the point of intersection by adding a random vector to the normal
-    // vector
-    ray scattered;
-    color attenuation;
-    // we return a color that comes from the direction of the random vector
-    if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-      return attenuation * ray_color(scattered, world, depth - 1);
-    return color(0, 0, 0);
-  }
-  // we take the unit vector of the ray's direction
-  vec3 unit_direction = unit_vector(r.direction());
-  // we map the y coordinate of the unit vector to the range [0,1]
-  auto t = 0.5 * (unit_direction.y() + 1.0);
-  // we linearly interpolate between white and blue
-  return (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
-}
+#include <string>
+#include <vector>
 
-hittable_list random_scene()
+void random_scene(scene_arena& world)
 {
-  hittable_list world;
-  auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-  world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+  // 1 ground sphere, at most 22 * 22 small spheres and 3 big ones
+  world.reserve(1 + 22 * 22 + 3);
+
+  auto ground_material = world.make_lambertian(color(0.5, 0.5, 0.5));
+  world.add_sphere(point3(0, -1000, 0), 1000, ground_material);
 
   for (int a = -11; a < 11; a++)
   {
@@ -57,46 +31,66 @@ hittable_list random_scene()
       point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
       if ((center - point3(4, 0.2, 0)).length() > 0.9)
       {
-        shared_ptr<material> sphere_material;
+        const material* sphere_material;
 
         if (choose_mat < 0.8)
         {
           // diffuse
           auto albedo = color::random() * color::random();
-          sphere_material = make_shared<lambertian>(albedo);
-          world.add(make_shared<sphere>(center, 0.2, sphere_material));
+          sphere_material = world.make_lambertian(albedo);
+          world.add_sphere(center, 0.2, sphere_material);
         }
         else if (choose_mat < 0.95)
         {
           // metal
           auto albedo = color::random(0.5, 1);
           auto fuzz = random_double(0, 0.5);
-          sphere_material = make_shared<metal>(albedo, fuzz);
-          world.add(make_shared<sphere>(center, 0.2, sphere_material));
+          sphere_material = world.make_metal(albedo, fuzz);
+          world.add_sphere(center, 0.2, sphere_material);
         }
         else
         {
           // glass
-          sphere_material = make_shared<dielectric>(1.5);
-          world.add(make_shared<sphere>(center, 0.2, sphere_material));
+          sphere_material = world.make_dielectric(1.5);
+          world.add_sphere(center, 0.2, sphere_material);
         }
       }
     }
   }
-  auto material1 = make_shared<dielectric>(1.5);
-  world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
-
-  auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-  world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+  auto material1 = world.make_dielectric(1.5);
+  world.add_sphere(point3(0, 1, 0), 1.0, material1);
 
-  auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-  world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+  auto material2 = world.make_lambertian(color(0.4, 0.2, 0.1));
+  world.add_sphere(point3(-4, 1, 0), 1.0, material2);
 
-  return world;
+  auto material3 = world.make_metal(color(0.7, 0.6, 0.5), 0.0);
+  world.add_sphere(point3(4, 1, 0), 1.0, material3);
 }
 
-int main()
+int main(int argc, char** argv)
 {
+  // ray_tracing --server <socket> keeps running and renders the jobs sent by render_client
+  if (argc == 3 && std::string(argv[1]) == "--server")
+    return run_render_server(argv[2]);
+
+  // ray_tracing --numa [--shared-scene] renders on every CPU with NUMA-aware thread placement
+  bool numa_mode = false;
+  numa_options numa;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (i == 1 && arg == "--numa")
+      numa_mode = true;
+    else if (numa_mode && arg == "--shared-scene")
+      numa.replicate_scene = false;
+    else
+    {
+      std::cerr << "unknown argument '" << arg << "'\n"
+                << "usage: " << argv[0] << " [--server <socket> | --numa [--shared-scene]]" << std::endl;
+      return 2;
+    }
+  }
+
   // Image
   const auto aspect_ratio = 3 / 2;
   const int image_width = 1200;
@@ -105,7 +99,9 @@ int main()
   const int max_depth = 50;
 
   // World
-  auto world = random_scene();
+  scene_arena world;
+  random_scene(world);
+  world.build_bvh();
 
   // Camera
   point3 lookfrom(13, 2, 3);
@@ -122,25 +118,31 @@ int main()
   // 255 is the maximum value of a color channel
   std::cout << "P3\n " << image_width << " " << image_height << "\n255\n";
 
+  if (numa_mode)
+  {
+    render_config config{ image_width, image_height, samples_per_pixel, max_depth };
+    tiled_framebuffer framebuffer(image_width, image_height, numa.tile_size);
+    auto report = render_numa(world, cam, config, numa, framebuffer);
+    for (int y = 0; y < image_height; ++y)
+      for (int x = 0; x < image_width; ++x)
+        write_color(std::cout, framebuffer.pixel(x, y), samples_per_pixel);
+    print_numa_report(std::cerr, report);
+    std::cerr << "file written" << std::endl;
+    return 0;
+  }
+
+  // the kernel specialized for the materials of the scene, the camera and the depth limit
+  render_config config{ image_width, image_height, samples_per_pixel, max_depth };
+  scanline_kernel kernel = select_kernel(world, cam, config);
+  std::vector<color> scanline(image_width);
+
   for (int j = image_height - 1; j >= 0; --j)
   {
     std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
+    // the u goes from 0 to 1 from left to right, the v goes from 0 to 1 from bottom to top
+    kernel(world, cam, config, j, 0, image_width, scanline.data());
     for (int i = 0; i < image_width; ++i)
-    {
-      color pixel_color(0, 0, 0);
-      for (int s = 0; s < samples_per_pixel; ++s)
-      {
-        // the u goes from 0 to 1 from left to right
-        auto u = (i + random_double()) / (image_width - 1);
-        // the v goes from 0 to 1 from bottom to top
-        auto v = (j + random_double()) / (image_height - 1);
-        // the ray r is casted from the camera origin to the projection plane
-        ray r = cam.get_ray(u, v);
-        // we add the color of the ray to the pixel color
-        pixel_color += ray_color(r, world, max_depth);
-      }
-      write_color(std::cout, pixel_color, samples_per_pixel);
-    }
+      write_color(std::cout, scanline[i], samples_per_pixel);
   }
   std::cerr << "file written" << std::endl;
   return 0;
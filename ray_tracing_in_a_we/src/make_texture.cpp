@@ -0,0 +1,34 @@
+#include "texture_cache.hpp"
+
+#include <iostream>
+#include <string>
+
+/*
+ *  Converts a PPM image to the tiled MIP pyramid read by the texture cache,
+ *  to be used in a scene description with "texture <name> <output>".
+ *
+ *  usage: make_texture <input.ppm> <output> [tile_size]
+ */
+
+int main(int argc, char** argv)
+{
+  if (argc != 3 && argc != 4)
+  {
+    std::cerr << "usage: " << argv[0] << " <input.ppm> <output> [tile_size]" << std::endl;
+    return 2;
+  }
+  int tile_size = argc == 4 ? std::stoi(argv[3]) : 32;
+  if (!valid_tile_size(tile_size))
+  {
+    std::cerr << "invalid tile size " << tile_size << std::endl;
+    return 2;
+  }
+
+  std::string error;
+  if (!make_tiled_texture(argv[1], argv[2], tile_size, error))
+  {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  return 0;
+}
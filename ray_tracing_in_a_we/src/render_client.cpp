@@ -0,0 +1,150 @@
+#include "rtweekend.hpp"
+
+#include "render_protocol.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/*
+ *  Client of the render server (ray_tracing --server <socket>).
+ *  It uploads a scene description, asks for a render of a region of the image and writes
+ *  the region as a PPM image on the standard output while the tiles arrive.
+ *
+ *  usage: render_client <socket> <scene file> [--size W H] [--spp N] [--depth N] [--region X0 Y0 X1 Y1]
+ *                       [--lookfrom X Y Z] [--lookat X Y Z] [--vup X Y Z] [--vfov D] [--aperture A] [--focus D]
+ */
+
+static bool parse_vec3(char** argv, int& i, int argc, vec3& v)
+{
+  if (i + 3 >= argc)
+    return false;
+  for (int k = 0; k < 3; k++)
+    v[k] = std::stod(argv[++i]);
+  return true;
+}
+
+static bool parse_options(int argc, char** argv, render_job& job)
+{
+  for (int i = 3; i < argc; i++)
+  {
+    std::string option = argv[i];
+    bool has_one = i + 1 < argc;
+    if (option == "--size" && i + 2 < argc)
+    {
+      job.width = std::stoi(argv[++i]);
+      job.height = std::stoi(argv[++i]);
+    }
+    else if (option == "--spp" && has_one)
+      job.samples_per_pixel = std::stoi(argv[++i]);
+    else if (option == "--depth" && has_one)
+      job.max_depth = std::stoi(argv[++i]);
+    else if (option == "--region" && i + 4 < argc)
+    {
+      job.x0 = std::stoi(argv[++i]);
+      job.y0 = std::stoi(argv[++i]);
+      job.x1 = std::stoi(argv[++i]);
+      job.y1 = std::stoi(argv[++i]);
+    }
+    else if (option == "--lookfrom" && parse_vec3(argv, i, argc, job.lookfrom))
+      continue;
+    else if (option == "--lookat" && parse_vec3(argv, i, argc, job.lookat))
+      continue;
+    else if (option == "--vup" && parse_vec3(argv, i, argc, job.vup))
+      continue;
+    else if (option == "--vfov" && has_one)
+      job.vfov = std::stod(argv[++i]);
+    else if (option == "--aperture" && has_one)
+      job.aperture = std::stod(argv[++i]);
+    else if (option == "--focus" && has_one)
+      job.focus_dist = std::stod(argv[++i]);
+    else
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  render_job job;
+  if (argc < 3 || !parse_options(argc, argv, job))
+  {
+    std::cerr << "usage: " << argv[0] << " <socket> <scene file> [--size W H] [--spp N] [--depth N]"
+              << " [--region X0 Y0 X1 Y1] [--lookfrom X Y Z] [--lookat X Y Z] [--vup X Y Z]"
+              << " [--vfov D] [--aperture A] [--focus D]" << std::endl;
+    return 1;
+  }
+  if (job.x1 == 0 && job.y1 == 0)
+  {
+    job.x1 = job.width;
+    job.y1 = job.height;
+  }
+
+  std::ifstream scene_file(argv[2]);
+  if (!scene_file)
+  {
+    std::cerr << "cannot read " << argv[2] << std::endl;
+    return 1;
+  }
+  std::stringstream scene;
+  scene << scene_file.rdbuf();
+
+  sockaddr_un addr;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || !unix_address(argv[1], addr) || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+  {
+    std::cerr << "cannot connect to " << argv[1] << std::endl;
+    return 1;
+  }
+
+  // upload the scene, the server answers with its key
+  std::string text = scene.str();
+  std::string reply;
+  if (!write_line(fd, "SCENE " + std::to_string(text.size())) || !write_all(fd, text.data(), text.size()) ||
+      !read_line(fd, reply) || reply.compare(0, 3, "OK ") != 0)
+  {
+    std::cerr << "scene rejected: " << reply << std::endl;
+    return 1;
+  }
+  job.scene = reply.substr(3);
+
+  if (!write_line(fd, format_render_job(job)))
+    return 1;
+
+  // collect the tiles of the region
+  int region_width = job.x1 - job.x0;
+  int region_height = job.y1 - job.y0;
+  std::vector<unsigned char> image(3 * region_width * region_height);
+  int tiles = 0;
+  while (read_line(fd, reply) && reply.compare(0, 5, "TILE ") == 0)
+  {
+    std::istringstream header(reply.substr(5));
+    int x, y, w, h;
+    header >> x >> y >> w >> h;
+    std::vector<unsigned char> pixels(3 * w * h);
+    if (!header || !read_exact(fd, pixels.data(), pixels.size()))
+      break;
+    for (int row = 0; row < h; row++)
+      std::copy(pixels.begin() + 3 * row * w, pixels.begin() + 3 * (row + 1) * w,
+                image.begin() + 3 * ((y - job.y0 + row) * region_width + (x - job.x0)));
+    std::cerr << "\rTiles received: " << ++tiles << ' ' << std::flush;
+  }
+  if (reply != "DONE")
+  {
+    std::cerr << "render failed: " << reply << std::endl;
+    return 1;
+  }
+  write_line(fd, "QUIT");
+  close(fd);
+
+  // P3 is the magic number for PPM
+  std::cout << "P3\n " << region_width << " " << region_height << "\n255\n";
+  for (std::size_t k = 0; k < image.size(); k += 3)
+    std::cout << static_cast<int>(image[k]) << ' ' << static_cast<int>(image[k + 1]) << ' '
+              << static_cast<int>(image[k + 2]) << '\n';
+  std::cerr << "file written" << std::endl;
+  return 0;
+}